@@ -0,0 +1,241 @@
+/** @file
+ *****************************************************************************
+ Encrypted checkpoint of an interrupted key generation.
+
+ See details in checkpoint.hpp .
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <libff/common/serialization.hpp>
+
+#include <checkpoint.hpp>
+
+namespace libsnark
+{
+
+// file: magic | salt | iv | ciphertext | tag, the magic is authenticated too
+static const unsigned char MAGIC[4] = {'C', 'S', 'C', 'K'};
+static const int PBKDF2_ITERATIONS = 100000;
+enum { SALT_SIZE = 16, IV_SIZE = 12, TAG_SIZE = 16, KEY_SIZE = 32 };
+
+/// wipes the plaintext and the key when leaving scope
+struct Secret {
+    std::string text;
+    unsigned char key[KEY_SIZE];
+
+    ~Secret()
+    {
+        if (!text.empty())
+            OPENSSL_cleanse(&text[0], text.size());
+        OPENSSL_cleanse(key, sizeof(key));
+    }
+};
+
+static bool deriveKey(const std::string &passphrase, const unsigned char *salt, unsigned char *key)
+{
+    return PKCS5_PBKDF2_HMAC(passphrase.data(), passphrase.size(), salt, SALT_SIZE,
+                             PBKDF2_ITERATIONS, EVP_sha256(), KEY_SIZE, key) == 1;
+}
+
+/// streambuf appending to a string. When the string has to grow, the old
+/// buffer is wiped before it is released, so no copy of the secret is freed
+/// uncleansed (unlike the internal buffer of an ostringstream).
+class SecretWriter : public std::streambuf {
+  public:
+    explicit SecretWriter(std::string &text) : text_(text) {}
+
+  protected:
+    int_type overflow(int_type c) override
+    {
+        if (traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+        if (text_.size() == text_.capacity()) {
+            std::string grown;
+            grown.reserve(2 * text_.capacity() + 256);
+            grown.append(text_);
+            if (!text_.empty())
+                OPENSSL_cleanse(&text_[0], text_.size());
+            text_.swap(grown);
+        }
+        text_.push_back(traits_type::to_char_type(c));
+        return c;
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        for (std::streamsize i = 0; i < n; i++)
+            overflow(traits_type::to_int_type(s[i]));
+        return n;
+    }
+
+  private:
+    std::string &text_;
+};
+
+/// streambuf reading a string in place, without the copy an istringstream makes
+class SecretReader : public std::streambuf {
+  public:
+    explicit SecretReader(const std::string &text)
+    {
+        char *p = const_cast<char*>(text.data());
+        setg(p, p, p + text.size());
+    }
+};
+
+static void serialize(const keygen_state &state, std::string &text)
+{
+    text.reserve(4096);
+    SecretWriter writer(text);
+    std::ostream out(&writer);
+    out << "csnark-keygen 2\n" << state.num_constraints << "\n" << state.num_inputs << "\n"
+        << state.num_variables << "\n" << state.sections << "\n" << state.offset << "\n"
+        << (state.fingerprint.empty() ? "-" : state.fingerprint) << "\n";
+    for (const FieldT *x : {&state.t, &state.alphaA, &state.alphaB, &state.alphaC,
+                            &state.rA, &state.rB, &state.beta, &state.gamma})
+        out << *x << OUTPUT_NEWLINE;
+}
+
+static bool deserialize(const std::string &text, keygen_state &state)
+{
+    SecretReader reader(text);
+    std::istream in(&reader);
+    std::string tag;
+    int version = 0;
+    in >> tag >> version >> state.num_constraints >> state.num_inputs
+       >> state.num_variables >> state.sections >> state.offset >> state.fingerprint;
+    if (state.fingerprint == "-")
+        state.fingerprint.clear();
+    libff::consume_newline(in);
+    for (FieldT *x : {&state.t, &state.alphaA, &state.alphaB, &state.alphaC,
+                      &state.rA, &state.rB, &state.beta, &state.gamma}) {
+        in >> *x;
+        libff::consume_OUTPUT_NEWLINE(in);
+    }
+    return !in.fail() && tag == "csnark-keygen" && version == 2 && state.sections <= KEYGEN_SECTIONS;
+}
+
+static bool writeAll(int fd, const void *data, size_t size)
+{
+    const char *p = (const char*)data;
+    while (size > 0) {
+        const ssize_t n = write(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool keygen_checkpoint_save(const std::string &path, const std::string &passphrase,
+                            const keygen_state &state)
+{
+    Secret secret;
+    serialize(state, secret.text);
+    unsigned char salt[SALT_SIZE], iv[IV_SIZE], tag[TAG_SIZE];
+    std::vector<unsigned char> cipher(secret.text.size());
+    if (RAND_bytes(salt, SALT_SIZE) != 1 || RAND_bytes(iv, IV_SIZE) != 1
+        || !deriveKey(passphrase, salt, secret.key))
+        return false;
+
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int len = 0, total = 0;
+    bool ok = ctx
+        && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, secret.key, iv) == 1
+        && EVP_EncryptUpdate(ctx, nullptr, &len, MAGIC, sizeof(MAGIC)) == 1
+        && EVP_EncryptUpdate(ctx, cipher.data(), &len, (const unsigned char*)secret.text.data(), secret.text.size()) == 1
+        && (total = len, EVP_EncryptFinal_ex(ctx, cipher.data() + total, &len) == 1)
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok)
+        return false;
+    cipher.resize(total + len);
+
+    // write a new file and rename it over the old checkpoint
+    const std::string tmp = path + ".tmp";
+    const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return false;
+    ok = writeAll(fd, MAGIC, sizeof(MAGIC)) && writeAll(fd, salt, SALT_SIZE) && writeAll(fd, iv, IV_SIZE)
+        && writeAll(fd, cipher.data(), cipher.size()) && writeAll(fd, tag, TAG_SIZE) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool keygen_checkpoint_load(const std::string &path, const std::string &passphrase,
+                            keygen_state &state)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    std::vector<unsigned char> data;
+    unsigned char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        data.insert(data.end(), buf, buf + n);
+    close(fd);
+    const size_t overhead = sizeof(MAGIC) + SALT_SIZE + IV_SIZE + TAG_SIZE;
+    if (n < 0 || data.size() < overhead || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+
+    const unsigned char *salt = data.data() + sizeof(MAGIC);
+    const unsigned char *iv = salt + SALT_SIZE;
+    const unsigned char *cipher = iv + IV_SIZE;
+    const size_t cipherSize = data.size() - overhead;
+    unsigned char tag[TAG_SIZE];
+    memcpy(tag, cipher + cipherSize, TAG_SIZE);
+
+    Secret secret;
+    secret.text.resize(cipherSize);
+    if (!deriveKey(passphrase, salt, secret.key))
+        return false;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int len = 0;
+    unsigned char *plain = (unsigned char*)&secret.text[0];
+    const bool ok = ctx
+        && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, secret.key, iv) == 1
+        && EVP_DecryptUpdate(ctx, nullptr, &len, MAGIC, sizeof(MAGIC)) == 1
+        && EVP_DecryptUpdate(ctx, plain, &len, cipher, cipherSize) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag) == 1
+        && EVP_DecryptFinal_ex(ctx, plain + len, &len) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok && deserialize(secret.text, state);
+}
+
+bool secure_wipe(const std::string &path)
+{
+    const int fd = open(path.c_str(), O_WRONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    static const char zeros[4096] = {0};
+    for (off_t done = 0; ok && done < st.st_size; done += sizeof(zeros))
+        ok = writeAll(fd, zeros, std::min<off_t>(sizeof(zeros), st.st_size - done));
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    return unlink(path.c_str()) == 0 && ok;
+}
+
+} // namespace libsnark
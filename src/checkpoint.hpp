@@ -0,0 +1,37 @@
+/** @file
+ *****************************************************************************
+ Encrypted checkpoint of an interrupted key generation.
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef LIBCSNARK_CHECKPOINT_HPP_
+#define LIBCSNARK_CHECKPOINT_HPP_
+
+#include <string>
+
+#include <keygen.hpp>
+
+namespace libsnark
+{
+
+/// Write state to path, encrypted and authenticated with AES-256-GCM under a
+/// key derived from passphrase (PBKDF2-HMAC-SHA256, random salt). The state
+/// holds the toxic waste of the key being generated, so the file is created
+/// 0600 and replaced atomically: a crash leaves the previous checkpoint.
+bool keygen_checkpoint_save(const std::string &path, const std::string &passphrase,
+                            const keygen_state &state);
+
+/// Read a checkpoint written by keygen_checkpoint_save. False if the file is
+/// missing, was written under another passphrase or has been modified.
+bool keygen_checkpoint_load(const std::string &path, const std::string &passphrase,
+                            keygen_state &state);
+
+/// Overwrite the file with zeros, sync and unlink it. Copy-on-write file
+/// systems and SSD wear leveling may still keep old blocks.
+bool secure_wipe(const std::string &path);
+
+} // namespace libsnark
+
+#endif // LIBCSNARK_CHECKPOINT_HPP_
@@ -9,13 +9,571 @@
  * @copyright  MIT license (see LICENSE file)
  *****************************************************************************/
 
+#include <algorithm>
+#include <climits>
 #include <cmath>
 #include <memory>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+#include <libff/algebra/fields/field_utils.hpp>
+
 #include <gadget2.hpp>
 
+#ifdef  DEBUG
+#define DBG_MSG(...)	printf(__VA_ARGS__)
+#else
+#define DBG_MSG(...)
+#endif
+
 namespace gadgetlib2
 {
+static bool annotations = true;
+
+void setAnnotations(bool enable)
+{
+    annotations = enable;
+}
+
+bool annotationsEnabled()
+{
+    return annotations;
+}
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                       DenseProtoboard                      ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+void SparseR1CS::Matrix::addRow(const GadgetLibAdapter::linear_combination_t& lc)
+{
+    for (const auto& term : lc.first) {
+        cols.emplace_back(term.first + 1);
+        coeffs.emplace_back(term.second);
+    }
+    cols.emplace_back(0);
+    coeffs.emplace_back(lc.second);
+    rowStart.emplace_back(cols.size());
+}
+
+GadgetLibAdapter::linear_combination_t SparseR1CS::Matrix::row(size_t r) const
+{
+    GadgetLibAdapter::linear_combination_t lc;
+    const size_t last = rowStart[r + 1] - 1; // the constant term
+    lc.first.reserve(last - rowStart[r]);
+    for (size_t k = rowStart[r]; k < last; k++)
+        lc.first.emplace_back(cols[k] - 1, coeffs[k]);
+    lc.second = coeffs[last];
+    return lc;
+}
+
+void SparseR1CS::addConstraint(const LinearCombination& a, const LinearCombination& b,
+                               const LinearCombination& c)
+{
+    const GadgetLibAdapter adapter;
+    A.addRow(adapter.convert(a));
+    B.addRow(adapter.convert(b));
+    C.addRow(adapter.convert(c));
+}
+
+size_t SparseR1CS::countUsedVariables(size_t rows) const
+{
+    ::std::vector<bool> used;
+    size_t count = 0;
+    for (const Matrix* m : {&A, &B, &C})
+        for (size_t k = 0; k < m->rowStart[rows]; k++) {
+            const size_t col = m->cols[k];
+            if (col == 0)
+                continue;
+            if (used.size() <= col)
+                used.resize(col + 1, false);
+            if (!used[col]) {
+                used[col] = true;
+                ++count;
+            }
+        }
+    return count;
+}
+
+size_t SparseR1CS::hashRow(size_t row) const
+{
+    // the columns and the row lengths tell constraints apart well enough, the
+    // coefficients are left to sameRow
+    size_t hash = 0;
+    for (const Matrix* m : {&A, &B, &C}) {
+        hash = hash * 31 + (m->rowStart[row + 1] - m->rowStart[row]);
+        for (size_t k = m->rowStart[row]; k < m->rowStart[row + 1]; k++)
+            hash = hash * 31 + m->cols[k];
+    }
+    return hash;
+}
+
+bool SparseR1CS::sameRow(size_t r, size_t s) const
+{
+    for (const Matrix* m : {&A, &B, &C}) {
+        const size_t len = m->rowStart[r + 1] - m->rowStart[r];
+        if (len != m->rowStart[s + 1] - m->rowStart[s])
+            return false;
+        for (size_t k = 0; k < len; k++)
+            if (m->cols[m->rowStart[r] + k] != m->cols[m->rowStart[s] + k]
+                || m->coeffs[m->rowStart[r] + k] != m->coeffs[m->rowStart[s] + k])
+                return false;
+    }
+    return true;
+}
+
+thread_local DenseProtoboard::ConstraintBuffer* DenseProtoboard::recording_ = NULL;
+
+DenseProtoboard::DenseProtoboard(const FieldType& fieldType)
+    : Protoboard(fieldType, ::std::make_shared<const Params>()), direct_(false)
+{
+    values_.reserve(GadgetLibAdapter::getNextFreeIndex());
+    tracked_.reserve(GadgetLibAdapter::getNextFreeIndex());
+    inverses_.resize(1);
+}
+
+ProtoboardPtr DenseProtoboard::create(const FieldType& fieldType)
+{
+    return ProtoboardPtr(new DenseProtoboard(fieldType));
+}
+
+void DenseProtoboard::track(size_t index)
+{
+    if (index >= tracked_.size()) {
+        // variables are allocated in index order, so grow to cover every one created so far
+        const size_t size = ::std::max(index + 1, (size_t)GadgetLibAdapter::getNextFreeIndex());
+        values_.resize(size);
+        tracked_.resize(size);
+    }
+    tracked_[index] = true;
+}
+
+FlatElem DenseProtoboard::val(const LinearCombination& lc)
+{
+    const GadgetLibAdapter::linear_combination_t terms = GadgetLibAdapter().convert(lc);
+    Fp sum = terms.second;
+    for (const auto& term : terms.first) {
+        if (term.first >= values_.size())
+            continue;
+        if (values_[term.first].state == DenseSlot::INVERSE)
+            resolveInverses();
+        sum += term.second * values_[term.first].field().asFp();
+    }
+    return FlatElem(sum);
+}
+
+void DenseProtoboard::reserve()
+{
+    const size_t size = GadgetLibAdapter::getNextFreeIndex();
+    if (values_.size() < size) {
+        values_.resize(size);
+        tracked_.resize(size);
+    }
+    // a slot left INVERSE by an earlier witness would resolve every queue from
+    // inside the parallel region when its gadget writes it again
+    resolveInverses();
+#ifdef MULTICORE
+    if (inverses_.size() < (size_t)omp_get_max_threads())
+        inverses_.resize(omp_get_max_threads());
+#endif
+}
+
+void DenseProtoboard::setInverse(const Variable& var, const FlatElem& x)
+{
+    GADGETLIB_ASSERT(x != 0, "DenseProtoboard::setInverse of zero");
+    const size_t index = GadgetLibAdapter::getVariableIndex(var);
+    if (index >= tracked_.size() || !tracked_[index])
+        track(index);
+    DenseSlot& slot = values_[index];
+    if (slot.state != DenseSlot::INVERSE) {
+#ifdef MULTICORE
+        const size_t thread = omp_get_thread_num();
+        GADGETLIB_ASSERT(thread < inverses_.size(), "DenseProtoboard::reserve not called before going parallel");
+        inverses_[thread].emplace_back(index);
+#else
+        inverses_[0].emplace_back(index);
+#endif
+    }
+    slot.elem = x;
+    slot.state = DenseSlot::INVERSE;
+}
+
+/// Montgomery's trick (libff::batch_invert): one inversion and 3(n-1)
+/// multiplications for n queued values
+void DenseProtoboard::resolveInverses()
+{
+#ifdef MULTICORE
+    GADGETLIB_ASSERT(!omp_in_parallel(), "DenseProtoboard::resolveInverses in a parallel region, call reserve() first");
+#endif
+    ::std::vector<size_t> indexes;
+    for (auto& queue : inverses_) {
+        indexes.insert(indexes.end(), queue.begin(), queue.end());
+        queue.clear();
+    }
+    if (indexes.empty())
+        return;
+    ::std::vector<Fp> elems;
+    elems.reserve(indexes.size());
+    for (size_t index : indexes)
+        elems.emplace_back(values_[index].elem.asFp());
+    libff::batch_invert(elems);
+    for (size_t i = 0; i < indexes.size(); i++)
+        values_[indexes[i]].setField(FlatElem(elems[i]));
+}
+
+long DenseProtoboard::firstIndexOf(const VariableArray& bits)
+{
+    if (bits.empty())
+        return -1;
+    const size_t first = GadgetLibAdapter::getVariableIndex(bits[0]);
+    for (size_t i = 1; i < bits.size(); i++)
+        if (GadgetLibAdapter::getVariableIndex(bits[i]) != first + i)
+            return -1;
+    return (long)first;
+}
+
+void DenseProtoboard::setBits(const VariableArray& bits, size_t first, uint64_t word)
+{
+    const size_t n = bits.size();
+    GADGETLIB_ASSERT(n <= 64, "DenseProtoboard::setBits of more than 64 bits");
+    if (first + n > tracked_.size() || !tracked_[first] || !tracked_[first + n - 1])
+        for (size_t i = 0; i < n; i++)
+            if (first + i >= tracked_.size() || !tracked_[first + i])
+                track(first + i);
+
+    // 0/1 are written with their field element, nothing left to materialize
+    static const FlatElem elems[2] = {FlatElem(0), FlatElem(1)};
+    DenseSlot* slot = &values_[first];
+#ifdef __AVX2__
+    if (sizeof(FlatElem) == sizeof(__m256i)) {
+        const __m256i zero = _mm256_loadu_si256((const __m256i*)&elems[0]);
+        const __m256i one = _mm256_loadu_si256((const __m256i*)&elems[1]);
+        for (size_t i = 0; i < n; i++, slot++) {
+            const uint64_t bit = (word >> i) & 1;
+            const __m256i mask = _mm256_set1_epi64x(-(long long)bit);
+            _mm256_storeu_si256((__m256i*)&slot->elem, _mm256_blendv_epi8(zero, one, mask));
+            slot->word = bit;
+            slot->state = DenseSlot::BOTH;
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++, slot++) {
+        const uint64_t bit = (word >> i) & 1;
+        slot->elem = elems[bit];
+        slot->word = bit;
+        slot->state = DenseSlot::BOTH;
+    }
+}
+
+bool DenseProtoboard::getBits(const VariableArray& bits, size_t first, uint64_t& word)
+{
+    const size_t n = bits.size();
+    if (first + n > tracked_.size())
+        return false;
+    uint64_t any = 0;
+    word = 0;
+    for (size_t i = 0; i < n; i++) {
+        const DenseSlot& slot = values_[first + i];
+        if (!tracked_[first + i] || !slot.hasWord())
+            return false;
+        any |= slot.word;
+        word |= slot.word << i;
+    }
+    // every bit 0/1 <=> no bit set above bit 0 in any word
+    return any <= 1;
+}
+
+void DenseProtoboard::materialize()
+{
+    resolveInverses();
+    for (auto& slot : values_)
+        slot.materialize();
+}
+
+void DenseProtoboard::flush()
+{
+    materialize();
+    for (const Variable& var : Protoboard::constraintSystem().getUsedVariables()) {
+        const size_t index = GadgetLibAdapter::getVariableIndex(var);
+        if (index < tracked_.size() && tracked_[index])
+            Protoboard::val(var) = values_[index].elem.asFElem();
+    }
+}
+
+void DenseProtoboard::addRank1Constraint(const LinearCombination& a,
+                                         const LinearCombination& b,
+                                         const LinearCombination& c,
+                                         const ::std::string& name)
+{
+    if (!recording_) {
+        emit(a, b, c, name);
+        return;
+    }
+    recording_->emplace_back();
+    RecordedConstraint& rec = recording_->back();
+    rec.a = a;
+    rec.b = b;
+    rec.c = c;
+    rec.name = name;
+}
+
+void DenseProtoboard::enforceBooleanity(const Variable& var)
+{
+    if (!recording_) {
+        emitBooleanity(var);
+        return;
+    }
+    recording_->emplace_back();
+    recording_->back().boolVar.reset(new Variable(var));
+}
+
+void DenseProtoboard::replay(const ConstraintBuffer& buffer)
+{
+    for (const auto& rec : buffer) {
+        if (rec.boolVar)
+            emitBooleanity(*rec.boolVar);
+        else
+            emit(rec.a, rec.b, rec.c, rec.name);
+    }
+}
+
+void DenseProtoboard::emit(const LinearCombination& a, const LinearCombination& b,
+                           const LinearCombination& c, const ::std::string& name)
+{
+    if (direct_)
+        sparse_.addConstraint(a, b, c);
+    else
+        Protoboard::addRank1Constraint(a, b, c, name);
+}
+
+/// same constraint as Protoboard::enforceBooleanity
+void DenseProtoboard::emitBooleanity(const Variable& var)
+{
+    if (direct_)
+        sparse_.addConstraint(var, 1 - var, 0);
+    else
+        Protoboard::enforceBooleanity(var);
+}
+
+bool DenseProtoboard::isSatisfied(const PrintOptions& printOnFail)
+{
+    materialize();
+    auto value = [this](size_t index) {
+        return index < values_.size() ? values_[index].elem.asFp() : Fp::zero();
+    };
+    for (size_t row = 0; row < sparse_.numConstraints(); row++) {
+        if (sparse_.A.evalRow(row, value) * sparse_.B.evalRow(row, value) != sparse_.C.evalRow(row, value)) {
+            if (printOnFail == PrintOptions::DBG_PRINT_IF_NOT_SATISFIED)
+                printf("!!! DenseProtoboard: sparse constraint %lu not satisfied\n", row);
+            return false;
+        }
+    }
+    flush();
+    return Protoboard::isSatisfied(printOnFail);
+}
+
+size_t DenseGadget::numConstraintsOf(const GadgetPtr& gadget)
+{
+    const DenseGadget* dense = dynamic_cast<const DenseGadget*>(gadget.get());
+    GADGETLIB_ASSERT(dense, "DenseGadget::numConstraintsOf: not a DenseGadget");
+    return dense->numConstraints();
+}
+
+void WitnessTape::append(DenseProtoboard& pb, const GadgetPtr& gadget)
+{
+    const DenseGadget* dense = dynamic_cast<const DenseGadget*>(gadget.get());
+    TapeOp op;
+    op.vars[0] = op.vars[1] = op.vars[2] = NULL;
+    op.constant = 0;
+    if (!dense || dense->densePb_ != &pb || !dense->tapeOp(op))
+        op.opcode = TapeOp::GADGET;
+
+    size_t index[3] = {0, 0, 0};
+    for (int k = 0; k < 3; k++)
+        if (op.opcode != TapeOp::GADGET && op.vars[k]) {
+            pb.val(*op.vars[k]);
+            index[k] = GadgetLibAdapter::getVariableIndex(*op.vars[k]);
+        }
+    opcodes_.emplace_back(op.opcode);
+    out_.emplace_back(index[0]);
+    in0_.emplace_back(index[1]);
+    in1_.emplace_back(index[2]);
+    constants_.emplace_back(op.constant);
+    gadgets_.emplace_back(gadget);
+}
+
+void WitnessTape::run(DenseProtoboard& pb, size_t i) const
+{
+    switch (opcodes_[i]) {
+    case TapeOp::ADD:
+        addWitness(pb.at(out_[i]), pb.at(in0_[i]), pb.at(in1_[i]));
+        break;
+    case TapeOp::SUB:
+        subWitness(pb.at(out_[i]), pb.at(in0_[i]), pb.at(in1_[i]));
+        break;
+    case TapeOp::MUL:
+        pb.at(out_[i]) = pb.at(in0_[i]).asLong() * pb.at(in1_[i]).asLong();
+        break;
+    case TapeOp::MULCONST:
+        pb.at(out_[i]) = pb.at(in0_[i]).asLong() * constants_[i];
+        break;
+    case TapeOp::AND:
+    case TapeOp::OR:
+        logicWitness(pb.at(out_[i]), pb.at(in0_[i]), pb.at(in1_[i]), opcodes_[i] == TapeOp::OR);
+        break;
+    default:
+        gadgets_[i]->generateWitness();
+    }
+}
+
+void WitnessTape::emitCode(::std::ostream& out, const ::std::string& symbol,
+                           const ::std::vector<bool>& live) const
+{
+    size_t slots = 0, liveOps = 0;
+    for (size_t i = 0; i < size(); i++) {
+        slots = ::std::max(slots, ::std::max(out_[i], ::std::max(in0_[i], in1_[i])) + 1);
+        liveOps += live[i];
+    }
+
+    out << "/* witness function generated by libcsnark (WitnessTape::emitCode), do not edit */\n"
+        << "#include \"witnessApi.h\"\n\n"
+        << "#define LOAD(s)    (v[s] = (unsigned char)api->load(api->ctx, s, &w[s]))\n"
+        << "#define STORE(s)   (v[s] = 1, api->store(api->ctx, s, w[s]))\n"
+        << "#define RUN(op, s) (api->run(api->ctx, op), LOAD(s))\n\n"
+        << "extern \"C\" const size_t " << symbol << "_ops = " << size() << ";\n"
+        << "extern \"C\" const size_t " << symbol << "_live = " << liveOps << ";\n"
+        << "extern \"C\" const uint64_t " << symbol << "_hash = " << hash(live) << "ull;\n\n"
+        << "extern \"C\" void " << symbol << "(const Witness_Api *api, uint64_t *w, unsigned char *v)\n{\n";
+
+    // w[s] / v[s] mirror slot s from its LOAD until the next interpreted gadget,
+    // which may write any slot
+    ::std::vector<size_t> loaded(slots, 0);
+    size_t epoch = 1;
+    auto use = [&](size_t slot) {
+        if (loaded[slot] != epoch) {
+            out << "\tLOAD(" << slot << ");\n";
+            loaded[slot] = epoch;
+        }
+    };
+    for (size_t i = 0; i < size(); i++) {
+        if (!live[i])
+            continue;
+        const size_t o = out_[i], a = in0_[i], b = in1_[i];
+        if (opcodes_[i] == TapeOp::GADGET) {
+            out << "\tapi->run(api->ctx, " << i << ");\n";
+            ++epoch;
+            continue;
+        }
+        use(a);
+        if (opcodes_[i] != TapeOp::MULCONST)
+            use(b);
+        out << "\t/* " << i << " */\n\t";
+        switch (opcodes_[i]) {
+        case TapeOp::ADD:
+            out << "if (v[" << a << "] && v[" << b << "] && !__builtin_add_overflow(w[" << a << "], w["
+                << b << "], &w[" << o << "])) STORE(" << o << ");";
+            break;
+        case TapeOp::SUB:
+            out << "if (v[" << a << "] && v[" << b << "] && w[" << a << "] >= w[" << b << "]) {w[" << o
+                << "] = w[" << a << "] - w[" << b << "]; STORE(" << o << ");}";
+            break;
+        case TapeOp::MUL:
+            // asLong() * asLong(), a negative product goes to the field
+            out << "if (v[" << a << "] && v[" << b << "] && (int64_t)(w[" << o << "] = w[" << a << "] * w["
+                << b << "]) >= 0) STORE(" << o << ");";
+            break;
+        case TapeOp::MULCONST:
+            out << "if (v[" << a << "] && (int64_t)(w[" << o << "] = w[" << a << "] * " << (uint64_t)constants_[i]
+                << "ull) >= 0) STORE(" << o << ");";
+            break;
+        case TapeOp::AND:
+        case TapeOp::OR:
+            out << "if (v[" << a << "] && v[" << b << "]) {w[" << o << "] = (w[" << a << "] != 0"
+                << (opcodes_[i] == TapeOp::OR ? " || " : " && ") << "w[" << b << "] != 0); STORE(" << o << ");}";
+            break;
+        }
+        out << " else RUN(" << i << ", " << o << ");\n";
+        loaded[o] = epoch;
+    }
+    out << "}\n";
+}
+
+uint64_t WitnessTape::hash(const ::std::vector<bool>& live) const
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value) {
+        for (int k = 0; k < 8; k++, value >>= 8)
+            hash = (hash ^ (value & 0xff)) * 1099511628211ull;
+    };
+    mix(size());
+    for (size_t i = 0; i < size(); i++) {
+        mix(opcodes_[i]);
+        mix(out_[i]);
+        mix(in0_[i]);
+        mix(in1_[i]);
+        mix((uint64_t)constants_[i]);
+        mix(live[i]);
+    }
+    return hash;
+}
+
+struct CompiledRun {
+    DenseProtoboard* pb;
+    const WitnessTape* tape;
+};
+
+static int compiledLoad(void* ctx, size_t slot, uint64_t* word)
+{
+    const FlatRef value = static_cast<CompiledRun*>(ctx)->pb->at(slot);
+    if (!value.hasWord())
+        return 0;
+    *word = (uint64_t)value.asLong();
+    return 1;
+}
+
+static void compiledStore(void* ctx, size_t slot, uint64_t word)
+{
+    static_cast<CompiledRun*>(ctx)->pb->at(slot) = (unsigned long)word;
+}
+
+static void compiledRun(void* ctx, size_t op)
+{
+    CompiledRun* run = static_cast<CompiledRun*>(ctx);
+    run->tape->run(*run->pb, op);
+}
+
+void WitnessTape::runCompiled(DenseProtoboard& pb, Witness_Func func) const
+{
+    CompiledRun run = {&pb, this};
+    const Witness_Api api = {&run, compiledLoad, compiledStore, compiledRun};
+    ::std::vector<uint64_t> words(pb.size());
+    ::std::vector<unsigned char> valid(pb.size());
+    func(&api, words.data(), valid.data());
+}
+
+void WitnessTape::clear()
+{
+    opcodes_.clear();
+    out_.clear();
+    in0_.clear();
+    in1_.clear();
+    constants_.clear();
+    gadgets_.clear();
+}
+/*********************************/
+/***  END OF DenseProtoboard   ***/
+/*********************************/
+
+
 /*************************************************************************************************/
 /*************************************************************************************************/
 /*******************                                                            ******************/
@@ -40,14 +598,28 @@ void R1P_ADD_Gadget::init() {}
 */
 void R1P_ADD_Gadget::generateConstraints()
 {
-    addRank1Constraint(lhs_ + rhs_, 1, result_, "(lhs_ + rhs) * 1 = result_");
+    addRank1Constraint(lhs_ + rhs_, 1, result_, GADGET_NAME("(lhs_ + rhs) * 1 = result_"));
+}
+
+size_t R1P_ADD_Gadget::numConstraints() const
+{
+    return 1;
 }
 
 void R1P_ADD_Gadget::generateWitness()
 {
-    val(result_) = val(lhs_) + val(rhs_);
+    addWitness(val(result_), val(lhs_), val(rhs_));
     printf("!!! %ld = %ld + %ld\n", val(result_).asLong(), val(lhs_).asLong(), val(rhs_).asLong());
 }
+
+bool R1P_ADD_Gadget::tapeOp(TapeOp& op) const
+{
+    op.opcode = TapeOp::ADD;
+    op.vars[0] = &result_;
+    op.vars[1] = &lhs_;
+    op.vars[2] = &rhs_;
+    return true;
+}
 /*********************************/
 /***    END OF R1P_ADD_Gadget  ***/
 /*********************************/
@@ -77,15 +649,28 @@ void R1P_SUB_Gadget::init() {}
 */
 void R1P_SUB_Gadget::generateConstraints()
 {
-    addRank1Constraint(lhs_ - rhs_, 1, result_, "(lhs_ - rhs) * 1 = result_");
+    addRank1Constraint(lhs_ - rhs_, 1, result_, GADGET_NAME("(lhs_ - rhs) * 1 = result_"));
 }
 
-void R1P_SUB_Gadget::generateWitness()
+size_t R1P_SUB_Gadget::numConstraints() const
 {
-    val(result_) = val(lhs_) - val(rhs_);
+    return 1;
+}
 
+void R1P_SUB_Gadget::generateWitness()
+{
+    subWitness(val(result_), val(lhs_), val(rhs_));
     printf("!!! %ld = %ld - %ld\n", val(result_).asLong(), val(lhs_).asLong(), val(rhs_).asLong());
 }
+
+bool R1P_SUB_Gadget::tapeOp(TapeOp& op) const
+{
+    op.opcode = TapeOp::SUB;
+    op.vars[0] = &result_;
+    op.vars[1] = &lhs_;
+    op.vars[2] = &rhs_;
+    return true;
+}
 /*********************************/
 /***    END OF R1P_SUB_Gadget  ***/
 /*********************************/
@@ -115,27 +700,32 @@ void R1P_NOT_Gadget::init() {}
 */
 void R1P_NOT_Gadget::generateConstraints()
 {
-    addRank1Constraint(input_, result_, 0, "input*result = 0");
+    addRank1Constraint(input_, result_, 0, GADGET_NAME("input*result = 0"));
     addRank1Constraint(input_, inputInverse_, temp1_,
-                       "input_ * result_ = temp1_");
+                       GADGET_NAME("input_ * result_ = temp1_"));
     addRank1Constraint(1 - temp1_, 1, result_,
-                       "1-temp1_ * 1 = result");
+                       GADGET_NAME("1-temp1_ * 1 = result"));
+}
+
+size_t R1P_NOT_Gadget::numConstraints() const
+{
+    return 3;
 }
 
 void R1P_NOT_Gadget::generateWitness()
 {
-    FElem inputVal = val(input_);
-    if (val(inputVal) == 0) {
+    const FlatElem inputVal = val(input_);
+    if (inputVal == 0) {
         val(inputInverse_) = 0;
         val(temp1_) = 0;
         val(result_) = 1;
     }
     else {
-        val(inputInverse_) = inputVal.inverse(R1P);
+        setInverse(inputInverse_, inputVal);
         val(temp1_) = 1;
         val(result_) = 0;
     }
-    printf("!!! %ld = ! %ld\n", val(result_).asLong(), val(inputVal).asLong());
+    printf("!!! %ld = ! %ld\n", val(result_).asLong(), inputVal.asLong());
 }
 /*********************************/
 /***    END OF R1P_NOT_Gadget  ***/
@@ -180,11 +770,11 @@ void R1P_MIN_Gadget::generateConstraints()
 {
     comparsionGadget_->generateConstraints();
 
-    addRank1Constraint(lhs_, less_, sym_1_, "lhs*less = sym_1");
+    addRank1Constraint(lhs_, less_, sym_1_, GADGET_NAME("lhs*less = sym_1"));
     addRank1Constraint(rhs_, 1 - less_, sym_2_,
-                       "rhs * (1-less) = sym_2");
+                       GADGET_NAME("rhs * (1-less) = sym_2"));
     addRank1Constraint(sym_1_ + sym_2_, 1, result_,
-                       "sym_1 + sym_2 * 1 = result");
+                       GADGET_NAME("sym_1 + sym_2 * 1 = result"));
 }
 
 void R1P_MIN_Gadget::generateWitness()
@@ -237,7 +827,7 @@ void R1P_SREM_Gadget::init()
 void R1P_SREM_Gadget::generateConstraints()
 {
     addRank1Constraint(B_, C_, A_ - result_,
-                       "B*C = A-result");
+                       GADGET_NAME("B*C = A-result"));
     /*
     comparsionGadget1_->generateConstraints();
     comparsionGadget2_->generateConstraints();
@@ -246,6 +836,11 @@ void R1P_SREM_Gadget::generateConstraints()
     */
 }
 
+size_t R1P_SREM_Gadget::numConstraints() const
+{
+    return 1;
+}
+
 void R1P_SREM_Gadget::generateWitness()
 {
   if(val(B_)==0){
@@ -291,11 +886,16 @@ void R1P_SDIV_Gadget::init()
 
 void R1P_SDIV_Gadget::generateConstraints()
 {
-    addRank1Constraint(result_, B_, A_-C_, "result * B = A - C");
+    addRank1Constraint(result_, B_, A_-C_, GADGET_NAME("result * B = A - C"));
   //  comparsionGadget1_->generateConstraints();
   //  comparsionGadget2_->generateConstraints();
 }
 
+size_t R1P_SDIV_Gadget::numConstraints() const
+{
+    return 1;
+}
+
 void R1P_SDIV_Gadget::generateWitness()
 {
   if(val(B_)==0){
@@ -342,6 +942,11 @@ void R1P_UREM_Gadget::generateConstraints()
     
 }
 
+size_t R1P_UREM_Gadget::numConstraints() const
+{
+    return numConstraintsOf(udivision_Gadget);
+}
+
 void R1P_UREM_Gadget::generateWitness()
 {
 
@@ -383,6 +988,11 @@ void R1P_UDIV_Gadget::generateConstraints()
     
 }
 
+size_t R1P_UDIV_Gadget::numConstraints() const
+{
+    return numConstraintsOf(udivision_Gadget);
+}
+
 void R1P_UDIV_Gadget::generateWitness()
 {
 
@@ -421,7 +1031,12 @@ void R1P_MUL_Gadget::init()
 //result < B
 void R1P_MUL_Gadget::generateConstraints()
 {
-    addRank1Constraint(A_, B_, result_, "A*B = result");
+    addRank1Constraint(A_, B_, result_, GADGET_NAME("A*B = result"));
+}
+
+size_t R1P_MUL_Gadget::numConstraints() const
+{
+    return 1;
 }
 
 void R1P_MUL_Gadget::generateWitness()
@@ -429,6 +1044,15 @@ void R1P_MUL_Gadget::generateWitness()
     val(result_) = val(A_).asLong() * val(B_).asLong();
     printf("!!! %ld = %ld * %ld\n", val(result_).asLong(), val(A_).asLong(), val(B_).asLong());
 }
+
+bool R1P_MUL_Gadget::tapeOp(TapeOp& op) const
+{
+    op.opcode = TapeOp::MUL;
+    op.vars[0] = &result_;
+    op.vars[1] = &A_;
+    op.vars[2] = &B_;
+    return true;
+}
 /*********************************/
 /***    END OF R1P_MUIT_Gadget  ***/
 /*********************************/
@@ -448,7 +1072,7 @@ R1P_BITWISE_OR_Gadget::R1P_BITWISE_OR_Gadget(ProtoboardPtr pb,
                                const Variable& B,
                                const Variable& result)
     : Gadget(pb), BITWISE_OR_GadgetBase(pb), R1P_Gadget(pb), A_(A), B_(B), result_(result),
-    A_alpha_u_(BIT_SIZE,  "A_alpha"), B_alpha_u_(BIT_SIZE,  "B_alpha"), sym_(BIT_SIZE, ""){}
+    A_alpha_u_(BIT_SIZE,  GADGET_NAME("A_alpha")), B_alpha_u_(BIT_SIZE,  GADGET_NAME("B_alpha")), sym_(BIT_SIZE, ""){}
 
 void R1P_BITWISE_OR_Gadget::init()
 {
@@ -456,7 +1080,7 @@ void R1P_BITWISE_OR_Gadget::init()
     alphaDualVariablePacker2_ = Packing_Gadget::create(pb_, B_alpha_u_, B_, false);
     alphaDualVariablePacker3_ = Packing_Gadget::create(pb_, sym_, result_, true);
     for (auto i = 0; i < BIT_SIZE; i++) 
-       orGadget_[i] = OR_Gadget::create(pb_, A_alpha_u_[i], B_alpha_u_[i], sym_[i]);
+       orGadget_[i] = LOGIC_Gadget::create(pb_, A_alpha_u_[i], B_alpha_u_[i], true, sym_[i]);
 }
 
 //bit0 = (A.O + B.O) > 0 ? 1 : 0
@@ -480,6 +1104,15 @@ void R1P_BITWISE_OR_Gadget::generateConstraints()
     alphaDualVariablePacker3_->generateConstraints();
 }
 
+size_t R1P_BITWISE_OR_Gadget::numConstraints() const
+{
+    size_t count = numConstraintsOf(alphaDualVariablePacker1_) + numConstraintsOf(alphaDualVariablePacker2_)
+                 + numConstraintsOf(alphaDualVariablePacker3_);
+    for (auto i = 0; i < BIT_SIZE; i++)
+        count += numConstraintsOf(orGadget_[i]);
+    return count;
+}
+
 void R1P_BITWISE_OR_Gadget::generateWitness()
 {
     alphaDualVariablePacker1_->generateWitness();
@@ -509,7 +1142,7 @@ R1P_BITWISE_XOR_Gadget::R1P_BITWISE_XOR_Gadget(ProtoboardPtr pb,
                                const Variable& B,
                                const Variable& result)
     : Gadget(pb), BITWISE_XOR_GadgetBase(pb), R1P_Gadget(pb), A_(A), B_(B), result_(result),
-    A_alpha_u_(BIT_SIZE,  "A_alpha"), B_alpha_u_(BIT_SIZE,  "B_alpha"), sym_(BIT_SIZE, ""){}
+    A_alpha_u_(BIT_SIZE,  GADGET_NAME("A_alpha")), B_alpha_u_(BIT_SIZE,  GADGET_NAME("B_alpha")), sym_(BIT_SIZE, ""){}
 
 void R1P_BITWISE_XOR_Gadget::init()
 {
@@ -542,6 +1175,15 @@ void R1P_BITWISE_XOR_Gadget::generateConstraints()
     alphaDualVariablePacker3_->generateConstraints();
 }
 
+size_t R1P_BITWISE_XOR_Gadget::numConstraints() const
+{
+    size_t count = numConstraintsOf(alphaDualVariablePacker1_) + numConstraintsOf(alphaDualVariablePacker2_)
+                 + numConstraintsOf(alphaDualVariablePacker3_);
+    for (auto i = 0; i < BIT_SIZE; i++)
+        count += numConstraintsOf(neqGadget_[i]);
+    return count;
+}
+
 void R1P_BITWISE_XOR_Gadget::generateWitness()
 {
     alphaDualVariablePacker1_->generateWitness();
@@ -572,7 +1214,7 @@ R1P_BITWISE_AND_Gadget::R1P_BITWISE_AND_Gadget(ProtoboardPtr pb,
                                const Variable& B,
                                const Variable& result)
     : Gadget(pb), BITWISE_AND_GadgetBase(pb), R1P_Gadget(pb), A_(A), B_(B), result_(result),
-    A_alpha_u_(BIT_SIZE,  "A_alpha"), B_alpha_u_(BIT_SIZE,  "B_alpha"), sym_(BIT_SIZE, ""){}
+    A_alpha_u_(BIT_SIZE,  GADGET_NAME("A_alpha")), B_alpha_u_(BIT_SIZE,  GADGET_NAME("B_alpha")), sym_(BIT_SIZE, ""){}
 
 void R1P_BITWISE_AND_Gadget::init()
 {
@@ -580,7 +1222,7 @@ void R1P_BITWISE_AND_Gadget::init()
     alphaDualVariablePacker2_ = Packing_Gadget::create(pb_, B_alpha_u_, B_, false);
     alphaDualVariablePacker3_ = Packing_Gadget::create(pb_, sym_, result_, true);
     for (auto i = 0; i < BIT_SIZE; i++) 
-       andGadget_[i] = AND_Gadget::create(pb_, A_alpha_u_[i], B_alpha_u_[i], sym_[i]);
+       andGadget_[i] = LOGIC_Gadget::create(pb_, A_alpha_u_[i], B_alpha_u_[i], false, sym_[i]);
 }
 
 //bit0 = (A.O + B.O) == 2 ? 1 : 0
@@ -604,6 +1246,15 @@ void R1P_BITWISE_AND_Gadget::generateConstraints()
     alphaDualVariablePacker3_->generateConstraints();
 }
 
+size_t R1P_BITWISE_AND_Gadget::numConstraints() const
+{
+    size_t count = numConstraintsOf(alphaDualVariablePacker1_) + numConstraintsOf(alphaDualVariablePacker2_)
+                 + numConstraintsOf(alphaDualVariablePacker3_);
+    for (auto i = 0; i < BIT_SIZE; i++)
+        count += numConstraintsOf(andGadget_[i]);
+    return count;
+}
+
 void R1P_BITWISE_AND_Gadget::generateWitness()
 {
     alphaDualVariablePacker1_->generateWitness();
@@ -635,7 +1286,7 @@ R1P_TRUNC_Gadget::R1P_TRUNC_Gadget(ProtoboardPtr pb,
                                const size_t &dstSize,
                                const Variable& result)
     : Gadget(pb), TRUNC_GadgetBase(pb), srcSize_(srcSize), dstSize_(dstSize),R1P_Gadget(pb), A_(A), result_(result),
-    A_alpha_u_(BIT_SIZE,  "A_alpha"), sym_(BIT_SIZE, ""){}
+    A_alpha_u_(BIT_SIZE,  GADGET_NAME("A_alpha")), sym_(BIT_SIZE, ""){}
 
 void R1P_TRUNC_Gadget::init()
 {
@@ -663,10 +1314,15 @@ void R1P_TRUNC_Gadget::generateConstraints()
 {
     alphaDualVariablePacker1_->generateConstraints();
     for (int i=0; i < dstSize_; i++)
-        addRank1Constraint(sym_[i] , 1, A_alpha_u_[i], "sym_[i] * 1 = A_alpha_u_[i]");
+        addRank1Constraint(sym_[i] , 1, A_alpha_u_[i], GADGET_NAME("sym_[i] * 1 = A_alpha_u_[i]"));
     alphaDualVariablePacker2_->generateConstraints();
 }
 
+size_t R1P_TRUNC_Gadget::numConstraints() const
+{
+    return numConstraintsOf(alphaDualVariablePacker1_) + dstSize_ + numConstraintsOf(alphaDualVariablePacker2_);
+}
+
 void R1P_TRUNC_Gadget::generateWitness()
 {
     alphaDualVariablePacker1_->generateWitness();
@@ -697,7 +1353,7 @@ R1P_ZEXT_Gadget::R1P_ZEXT_Gadget(ProtoboardPtr pb,
                                const size_t &dstSize,
                                const Variable& result)
     : Gadget(pb), ZEXT_GadgetBase(pb), srcSize_(srcSize), dstSize_(dstSize), R1P_Gadget(pb), A_(A), result_(result),
-     A_alpha_u_(BIT_SIZE,  "A_alpha"),sym_(BIT_SIZE, ""){}
+     A_alpha_u_(BIT_SIZE,  GADGET_NAME("A_alpha")),sym_(BIT_SIZE, ""){}
 
 void R1P_ZEXT_Gadget::init()
 {
@@ -723,10 +1379,15 @@ void R1P_ZEXT_Gadget::generateConstraints()
 {
     alphaDualVariablePacker1_->generateConstraints();
     for (int i=0; i < srcSize_; i++)
-        addRank1Constraint(sym_[i] , 1, A_alpha_u_[i], "sym_[i] * 1 = A_alpha_u_[i]");
+        addRank1Constraint(sym_[i] , 1, A_alpha_u_[i], GADGET_NAME("sym_[i] * 1 = A_alpha_u_[i]"));
     alphaDualVariablePacker2_->generateConstraints();
 }
 
+size_t R1P_ZEXT_Gadget::numConstraints() const
+{
+    return numConstraintsOf(alphaDualVariablePacker1_) + srcSize_ + numConstraintsOf(alphaDualVariablePacker2_);
+}
+
 void R1P_ZEXT_Gadget::generateWitness()
 {
     alphaDualVariablePacker1_->generateWitness();
@@ -755,7 +1416,7 @@ R1P_SEXT_Gadget::R1P_SEXT_Gadget(ProtoboardPtr pb,
                                const size_t &dstSize,
                                const Variable& result)
     : Gadget(pb), SEXT_GadgetBase(pb), srcSize_(srcSize), dstSize_(dstSize), R1P_Gadget(pb), A_(A), result_(result),
-    A_alpha_u_(BIT_SIZE,  "A_alpha"), sym_(BIT_SIZE, ""){}
+    A_alpha_u_(BIT_SIZE,  GADGET_NAME("A_alpha")), sym_(BIT_SIZE, ""){}
 
 void R1P_SEXT_Gadget::init()
 {
@@ -776,12 +1437,17 @@ void R1P_SEXT_Gadget::generateConstraints()
 {
     alphaDualVariablePacker1_->generateConstraints();
     for (int i = 0; i < srcSize_ ; i++)
-        addRank1Constraint(sym_[i] - A_alpha_u_[i], 1, 0, "(sym[i] - A[i]) * 1 = 0");
+        addRank1Constraint(sym_[i] - A_alpha_u_[i], 1, 0, GADGET_NAME("(sym[i] - A[i]) * 1 = 0"));
     for (int i = srcSize_; i < dstSize_; i++)
-        addRank1Constraint(sym_[i] - A_alpha_u_[srcSize_-1], 1, 0, "(sym[i] - A[srcSize_-1]) * 1 = 0");
+        addRank1Constraint(sym_[i] - A_alpha_u_[srcSize_-1], 1, 0, GADGET_NAME("(sym[i] - A[srcSize_-1]) * 1 = 0"));
     alphaDualVariablePacker2_->generateConstraints();
 }
 
+size_t R1P_SEXT_Gadget::numConstraints() const
+{
+    return numConstraintsOf(alphaDualVariablePacker1_) + dstSize_ + numConstraintsOf(alphaDualVariablePacker2_);
+}
+
 void R1P_SEXT_Gadget::generateWitness()
 {
     alphaDualVariablePacker1_->generateWitness();
@@ -828,8 +1494,13 @@ void R1P_EQ_Gadget::init()
 */
 void R1P_EQ_Gadget::generateConstraints()
 {
-    addRank1Constraint(A_ - B_, result_, 0, "(A - B) * result = 0");
-    addRank1Constraint(A_ - B_, aux_, 1 - result_, "(A - B) * aux = 1 - result");
+    addRank1Constraint(A_ - B_, result_, 0, GADGET_NAME("(A - B) * result = 0"));
+    addRank1Constraint(A_ - B_, aux_, 1 - result_, GADGET_NAME("(A - B) * aux = 1 - result"));
+}
+
+size_t R1P_EQ_Gadget::numConstraints() const
+{
+    return 2;
 }
 
 void R1P_EQ_Gadget::generateWitness()
@@ -837,7 +1508,7 @@ void R1P_EQ_Gadget::generateWitness()
     if (val(A_) == val(B_))
         val(aux_) = 0;
     else
-        val(aux_) = (val(A_) - val(B_)).inverse(R1P);
+        setInverse(aux_, val(A_) - val(B_));
     val(result_) = (val(A_) == val(B_) ? 1 : 0) ;
     printf("!!! %ld = %ld == %ld\n", val(result_).asLong(), val(A_).asLong(), val(B_).asLong());
 }
@@ -876,8 +1547,13 @@ void R1P_NEQ_Gadget::init()
 */
 void R1P_NEQ_Gadget::generateConstraints()
 {
-    addRank1Constraint(A_ - B_, aux_, result_, "(A - B) * aux = result");
-    addRank1Constraint(A_ - B_, 1 - result_, 0, "(A - B) * (1 - result) = 0");
+    addRank1Constraint(A_ - B_, aux_, result_, GADGET_NAME("(A - B) * aux = result"));
+    addRank1Constraint(A_ - B_, 1 - result_, 0, GADGET_NAME("(A - B) * (1 - result) = 0"));
+}
+
+size_t R1P_NEQ_Gadget::numConstraints() const
+{
+    return 2;
 }
 
 void R1P_NEQ_Gadget::generateWitness()
@@ -885,7 +1561,7 @@ void R1P_NEQ_Gadget::generateWitness()
     if (val(A_) == val(B_))
         val(aux_) = 0;
     else
-        val(aux_) = (val(A_) - val(B_)).inverse(R1P);
+        setInverse(aux_, val(A_) - val(B_));
     val(result_) = (val(A_) != val(B_) ? 1 : 0) ;
     printf("!!! %ld = %ld != %ld\n", val(result_).asLong(), val(A_).asLong(), val(B_).asLong());
 }
@@ -924,10 +1600,15 @@ GadgetPtr SGT_Gadget::create(ProtoboardPtr pb,
 
 void SGT_Gadget::generateConstraints()
 {    
-    addRank1Constraint(1, B_ - A_, C_, "B_ - A_ = C_");
+    addRank1Constraint(1, B_ - A_, C_, GADGET_NAME("B_ - A_ = C_"));
     getbitGadget->generateConstraints();
 }
 
+size_t SGT_Gadget::numConstraints() const
+{
+    return 1 + numConstraintsOf(getbitGadget);
+}
+
 void SGT_Gadget::generateWitness()
 {
     val(C_) = val(B_) - val(A_);
@@ -974,7 +1655,12 @@ void SGE_Gadget::generateConstraints()
     sgtGadget_->generateConstraints();
     eqGadget_->generateConstraints();
 
-    addRank1Constraint(great_ + eq_, 1, result_, "great_ + eq__ = result");
+    addRank1Constraint(great_ + eq_, 1, result_, GADGET_NAME("great_ + eq__ = result"));
+}
+
+size_t SGE_Gadget::numConstraints() const
+{
+    return numConstraintsOf(sgtGadget_) + numConstraintsOf(eqGadget_) + 1;
 }
 
 void SGE_Gadget::generateWitness()
@@ -1025,7 +1711,7 @@ GadgetPtr UGT_Gadget::create(ProtoboardPtr pb,
 
 void UGT_Gadget::generateConstraints()
 {    
-    addRank1Constraint(1, B_ - A_, C_, "B_ - A_ = C_");
+    addRank1Constraint(1, B_ - A_, C_, GADGET_NAME("B_ - A_ = C_"));
     A_SIGN_GADGET->generateConstraints();
     B_SIGN_GADGET->generateConstraints();
     C_SIGN_GADGET->generateConstraints();
@@ -1033,6 +1719,12 @@ void UGT_Gadget::generateConstraints()
     Select_GADGET->generateConstraints();
 }
 
+size_t UGT_Gadget::numConstraints() const
+{
+    return 1 + numConstraintsOf(A_SIGN_GADGET) + numConstraintsOf(B_SIGN_GADGET) + numConstraintsOf(C_SIGN_GADGET)
+             + numConstraintsOf(EQ_GADGET) + numConstraintsOf(Select_GADGET);
+}
+
 void UGT_Gadget::generateWitness()
 {
     val(C_) = val(B_) - val(A_);
@@ -1083,7 +1775,12 @@ void UGE_Gadget::generateConstraints()
     ugtGadget_->generateConstraints();
     eqGadget_->generateConstraints();
 
-    addRank1Constraint(great_ + eq_, 1, result_, "great_ + eq__ = result");
+    addRank1Constraint(great_ + eq_, 1, result_, GADGET_NAME("great_ + eq__ = result"));
+}
+
+size_t UGE_Gadget::numConstraints() const
+{
+    return numConstraintsOf(ugtGadget_) + numConstraintsOf(eqGadget_) + 1;
 }
 
 void UGE_Gadget::generateWitness()
@@ -1135,7 +1832,12 @@ GadgetPtr Select_Gadget::create(ProtoboardPtr pb,
 
 void Select_Gadget::generateConstraints() {
     addRank1Constraint(toggle_, oneValue_ - zeroValue_, result_ - zeroValue_,
-                            "result = (1 - toggle) * zeroValue + toggle * oneValue");
+                            GADGET_NAME("result = (1 - toggle) * zeroValue + toggle * oneValue"));
+}
+
+size_t Select_Gadget::numConstraints() const
+{
+    return 1;
 }
 
 void Select_Gadget::generateWitness() {
@@ -1155,6 +1857,59 @@ void Select_Gadget::generateWitness() {
 /***  END OF R1P_Select_Gadget ***/
 /*********************************/
 
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                        LOGIC_Gadget                        ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+LOGIC_Gadget::LOGIC_Gadget(ProtoboardPtr pb,
+                           const Variable& A,
+                           const Variable& B,
+                           bool isOr,
+                           const Variable& result)
+        : Gadget(pb), A_(A), B_(B), isOr_(isOr), result_(result) {}
+
+GadgetPtr LOGIC_Gadget::create(ProtoboardPtr pb,
+                               const Variable& A,
+                               const Variable& B,
+                               bool isOr,
+                               const Variable& result) {
+    GadgetPtr pGadget(new LOGIC_Gadget(pb, A, B, isOr, result));
+    pGadget->init();
+    return pGadget;
+}
+
+void LOGIC_Gadget::generateConstraints() {
+    if (isOr_)
+        addRank1Constraint(A_, B_, A_ + B_ - result_, GADGET_NAME("A * B = A + B - result"));
+    else
+        addRank1Constraint(A_, B_, result_, GADGET_NAME("A * B = result"));
+}
+
+size_t LOGIC_Gadget::numConstraints() const
+{
+    return 1;
+}
+
+void LOGIC_Gadget::generateWitness() {
+    logicWitness(val(result_), val(A_), val(B_), isOr_);
+}
+
+bool LOGIC_Gadget::tapeOp(TapeOp& op) const {
+    op.opcode = isOr_ ? TapeOp::OR : TapeOp::AND;
+    op.vars[0] = &result_;
+    op.vars[1] = &A_;
+    op.vars[2] = &B_;
+    return true;
+}
+
+/*********************************/
+/***    END OF LOGIC_Gadget    ***/
+/*********************************/
+
 /*************************************************************************************************/
 /*************************************************************************************************/
 /*******************                                                            ******************/
@@ -1167,7 +1922,8 @@ Packing_Gadget::Packing_Gadget(ProtoboardPtr pb,
                                const VariableArray& unpacked,
                                const Variable& packed,
                                bool ispacking)
-    : Gadget(pb), unpacked_(unpacked), packed_(packed), ispacking(ispacking) {
+    : Gadget(pb), unpacked_(unpacked), packed_(packed), ispacking(ispacking),
+      firstBit_(DenseProtoboard::firstIndexOf(unpacked)) {
     GADGETLIB_ASSERT(unpacked.size() > 0, "Attempted to pack 0 bits in R1P.")
 }
 
@@ -1191,26 +1947,51 @@ void Packing_Gadget::generateConstraints() {
         two_i += two_i;
         if (!ispacking) {enforceBooleanity(unpacked_[i]);}
     }
-    addRank1Constraint(packed_, 1, packed, "packed = sum(2^i * unpacked[i])");
+    addRank1Constraint(packed_, 1, packed, GADGET_NAME("packed = sum(2^i * unpacked[i])"));
     
 }
 
+size_t Packing_Gadget::numConstraints() const
+{
+    return (ispacking ? 0 : unpacked_.size()) + 1;
+}
+
 void Packing_Gadget::generateWitness() {
     const int n = unpacked_.size();
+    const bool wordLevel = densePb() && firstBit_ >= 0 && n <= 64;
     if (ispacking) {
-        FElem packedVal = 0;
-        FElem two_i(1); // will hold 2^i
+        uint64_t packedWord = 0;
+        if (wordLevel && densePb()->getBits(unpacked_, firstBit_, packedWord)) {
+            val(packed_) = (unsigned long)packedWord;
+            return;
+        }
+        packedWord = 0;
+        FlatElem packedVal = 0;
+        FlatElem two_i(1); // will hold 2^i
         for(int i = 0; i < n; ++i) {
-            GADGETLIB_ASSERT(val(unpacked_[i]).asLong() == 0 || val(unpacked_[i]).asLong() == 1,
-                         GADGETLIB2_FMT("unpacked[%u]  = %u. Expected a Boolean value.", i,
-                             val(unpacked_[i]).asLong()));
-            packedVal += two_i * val(unpacked_[i]).asLong();
+            const long bit = val(unpacked_[i]).asLong();
+            GADGETLIB_ASSERT(bit == 0 || bit == 1,
+                         GADGETLIB2_FMT("unpacked[%u]  = %u. Expected a Boolean value.", i, bit));
+            if (n <= 64) {
+                packedWord |= (uint64_t)bit << i;
+                continue;
+            }
+            if (bit)
+                packedVal += two_i;
             two_i += two_i;
         }
-        val(packed_) = packedVal;
+        if (n <= 64)
+            val(packed_) = (unsigned long)packedWord;
+        else
+            val(packed_) = packedVal;
     } else {
+        const uint64_t packedWord = (uint64_t)val(packed_).asLong();
+        if (wordLevel) {
+            densePb()->setBits(unpacked_, firstBit_, packedWord);
+            return;
+        }
         for(int i = 0; i < n; ++i) {
-            val(unpacked_[i]) = (val(packed_).asLong() >> i) & 1;
+            val(unpacked_[i]) = (long)(i < 64 ? (packedWord >> i) & 1 : 0);
         }
     }
 }
@@ -1232,7 +2013,7 @@ GETBIT_Gadget::GETBIT_Gadget(ProtoboardPtr pb,
                                const Variable& A,
                                const unsigned i,
                                const Variable& result)
-: Gadget(pb), A_(A), i(i), result_(result), A_alpha_u_(BIT_SIZE,  "A_alpha"){}
+: Gadget(pb), A_(A), i(i), result_(result), A_alpha_u_(BIT_SIZE,  GADGET_NAME("A_alpha")){}
 
 void GETBIT_Gadget::init(){
     alphaDualVariablePacker1_ = Packing_Gadget::create(pb_, A_alpha_u_, A_, false);
@@ -1251,7 +2032,12 @@ void GETBIT_Gadget::generateConstraints()
 {
   alphaDualVariablePacker1_->generateConstraints();
 
-  addRank1Constraint(A_alpha_u_[i] , 1, result_, "result_ = A_alpha_u_[i]");
+  addRank1Constraint(A_alpha_u_[i] , 1, result_, GADGET_NAME("result_ = A_alpha_u_[i]"));
+}
+
+size_t GETBIT_Gadget::numConstraints() const
+{
+    return numConstraintsOf(alphaDualVariablePacker1_) + 1;
 }
 
 void GETBIT_Gadget::generateWitness()
@@ -1302,7 +2088,12 @@ void UDivision_Gadget::generateConstraints()
  //   addRank1Constraint(B_, Q_, A_-R_, "B * Q = A - R");
     comparsionGadget_->generateConstraints();
 
-    addRank1Constraint(less_ , 1, 1, "less = 1");
+    addRank1Constraint(less_ , 1, 1, GADGET_NAME("less = 1"));
+}
+
+size_t UDivision_Gadget::numConstraints() const
+{
+    return numConstraintsOf(comparsionGadget_) + 1;
 }
 
 void UDivision_Gadget::generateWitness()
@@ -1329,6 +2120,713 @@ void UDivision_Gadget::generateWitness()
 /*********************************/
 
 
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                      MULConst_Gadget                       ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+MULConst_Gadget::MULConst_Gadget(ProtoboardPtr pb,
+                               const Variable& A,
+                               const long c,
+                               const Variable& result)
+    : Gadget(pb), A_(A), c_(c), result_(result) {}
+
+void MULConst_Gadget::init() {}
+
+GadgetPtr MULConst_Gadget::create(ProtoboardPtr pb,
+                               const Variable& A,
+                               const long c,
+                               const Variable& result){
+    GadgetPtr pGadget(new MULConst_Gadget(pb, A, c, result));
+    pGadget->init();
+    return pGadget;
+}
+
+/*
+    Constraint breakdown:
+    (1) (A * c) * 1 = result
+*/
+void MULConst_Gadget::generateConstraints()
+{
+    addRank1Constraint(A_ * FElem(c_), 1, result_, GADGET_NAME("(A * c) * 1 = result"));
+}
+
+size_t MULConst_Gadget::numConstraints() const
+{
+    return 1;
+}
+
+void MULConst_Gadget::generateWitness()
+{
+    val(result_) = val(A_).asLong() * c_;
+    DBG_MSG("!!! %ld = %ld * %ld\n", val(result_).asLong(), val(A_).asLong(), c_);
+}
+
+bool MULConst_Gadget::tapeOp(TapeOp& op) const
+{
+    op.opcode = TapeOp::MULCONST;
+    op.vars[0] = &result_;
+    op.vars[1] = &A_;
+    op.vars[2] = NULL;
+    op.constant = c_;
+    return true;
+}
+
+/*********************************/
+/***   END OF MULConst_Gadget  ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                   UDivisionConst_Gadget                    ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+UDivisionConst_Gadget::UDivisionConst_Gadget(ProtoboardPtr pb,
+                               const Variable& A,
+                               const unsigned long c,
+                               const Variable& Q,
+                               const Variable& R)
+    : Gadget(pb), A_(A), c_(c), Q_(Q), R_(R), bitlenc_(bitLength(c)), log2c_(bitLength(c) - 1),
+    A_alpha_u_(isPowerOfTwo(c) ? BIT_SIZE : 0, GADGET_NAME("A_alpha")),
+    Q_alpha_u_(isPowerOfTwo(c) ? 0 : BIT_SIZE - log2c_, GADGET_NAME("Q_alpha")),
+    R_alpha_u_(isPowerOfTwo(c) ? 0 : bitlenc_, GADGET_NAME("R_alpha")),
+    S_alpha_u_(isPowerOfTwo(c) ? 0 : bitlenc_, GADGET_NAME("S_alpha")) {
+    GADGETLIB_ASSERT(c != 0, "Attempted to create UDivisionConst_Gadget with c == 0.");
+}
+
+void UDivisionConst_Gadget::init()
+{
+    if (isPowerOfTwo(c_)) {
+        for (size_t i = 0; i < BIT_SIZE; i++) {
+            if (i < log2c_)
+                R_alpha_u_.emplace_back(A_alpha_u_[i]);
+            else
+                Q_alpha_u_.emplace_back(A_alpha_u_[i]);
+        }
+        alphaDualVariablePacker1_ = Packing_Gadget::create(pb_, A_alpha_u_, A_, false);
+        alphaDualVariablePacker2_ = Packing_Gadget::create(pb_, Q_alpha_u_, Q_, true);
+        if (log2c_ > 0)
+            alphaDualVariablePacker3_ = Packing_Gadget::create(pb_, R_alpha_u_, R_, true);
+    } else {
+        GADGETLIB_ASSERT(c_ <= (unsigned long)LONG_MAX, "UDivisionConst_Gadget: divisor out of range.");
+        alphaDualVariablePacker2_ = Packing_Gadget::create(pb_, Q_alpha_u_, Q_, false);
+        alphaDualVariablePacker3_ = Packing_Gadget::create(pb_, R_alpha_u_, R_, false);
+        alphaDualVariablePacker4_ = Packing_Gadget::create(pb_, S_alpha_u_, S_, false);
+    }
+}
+
+GadgetPtr UDivisionConst_Gadget::create(ProtoboardPtr pb,
+                            const Variable& A,
+                            const unsigned long c,
+                            const Variable& Q,
+                            const Variable& R){
+    GadgetPtr pGadget(new UDivisionConst_Gadget(pb, A, c, Q, R));
+    pGadget->init();
+    return pGadget;
+}
+
+/*
+    Constraint breakdown (c == 2^k):
+    A_alpha_u_ = A.unpacked                                    (64 + 1)
+    Q = A_alpha_u_[k..63].packed                               (1)
+    R = A_alpha_u_[0..k-1].packed                              (1)
+
+    Constraint breakdown (otherwise, n = bitlen(c), m = floor(log2 c)):
+    (1) (Q * c) * 1 = A - R                                    (1)
+    (2) (c - 1 - R) * 1 = S                                    (1)
+    R = R_alpha_u_.packed,  R_alpha_u_ is n bits               (n + 1)
+    S = S_alpha_u_.packed,  S_alpha_u_ is n bits  ==> R < c    (n + 1)
+    Q = Q_alpha_u_.packed,  Q_alpha_u_ is 64 - m bits          (64 - m + 1)
+*/
+void UDivisionConst_Gadget::generateConstraints()
+{
+    if (isPowerOfTwo(c_)) {
+        alphaDualVariablePacker1_->generateConstraints();
+        alphaDualVariablePacker2_->generateConstraints();
+        if (log2c_ > 0)
+            alphaDualVariablePacker3_->generateConstraints();
+        else
+            addRank1Constraint(R_, 1, 0, GADGET_NAME("R * 1 = 0"));
+    } else {
+        addRank1Constraint(Q_ * FElem((long)c_), 1, A_ - R_, GADGET_NAME("(Q * c) * 1 = A - R"));
+        addRank1Constraint(LinearCombination((long)c_ - 1) - R_, 1, S_, GADGET_NAME("(c - 1 - R) * 1 = S"));
+        alphaDualVariablePacker2_->generateConstraints();
+        alphaDualVariablePacker3_->generateConstraints();
+        alphaDualVariablePacker4_->generateConstraints();
+    }
+}
+
+size_t UDivisionConst_Gadget::numConstraints() const
+{
+    if (isPowerOfTwo(c_))
+        return numConstraintsOf(alphaDualVariablePacker1_) + numConstraintsOf(alphaDualVariablePacker2_)
+               + (log2c_ > 0 ? numConstraintsOf(alphaDualVariablePacker3_) : 1);
+    return 2 + numConstraintsOf(alphaDualVariablePacker2_) + numConstraintsOf(alphaDualVariablePacker3_)
+           + numConstraintsOf(alphaDualVariablePacker4_);
+}
+
+void UDivisionConst_Gadget::generateWitness()
+{
+    if (isPowerOfTwo(c_)) {
+        alphaDualVariablePacker1_->generateWitness();
+        alphaDualVariablePacker2_->generateWitness();
+        if (log2c_ > 0)
+            alphaDualVariablePacker3_->generateWitness();
+        else
+            val(R_) = 0;
+    } else {
+        unsigned long a = (unsigned long)(val(A_).asLong());
+        val(Q_) = (long)(a / c_);
+        val(R_) = (long)(a % c_);
+        val(S_) = (long)(c_ - 1 - a % c_);
+        alphaDualVariablePacker2_->generateWitness();
+        alphaDualVariablePacker3_->generateWitness();
+        alphaDualVariablePacker4_->generateWitness();
+    }
+    DBG_MSG("!!! %lu, %lu = %lu /%% %lu\n", val(Q_).asLong(), val(R_).asLong(), val(A_).asLong(), c_);
+}
+
+/*********************************/
+/*** END OF UDivisionConst_Gadget ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                      CMPConst_Gadget                       ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+CMPConst_Gadget::CMPConst_Gadget(ProtoboardPtr pb,
+                               const Variable& A,
+                               const unsigned long c,
+                               const bool isSigned,
+                               const bool orEqual,
+                               const bool constIsLhs,
+                               const Variable& result)
+    : Gadget(pb), A_(A), c_(c), isSigned_(isSigned), isNegative_(isSigned && (long)c < 0),
+      orEqual_(orEqual), constIsLhs_(constIsLhs), result_(result),
+      bitlenc_(UDivisionConst_Gadget::bitLength(isSigned && (long)c < 0 ? ~c : c)),
+      A_alpha_u_(BIT_SIZE, GADGET_NAME("A_alpha")), prod_(bitlenc_, GADGET_NAME("prod")) {}
+
+void CMPConst_Gadget::init()
+{
+    alphaDualVariablePacker1_ = Packing_Gadget::create(pb_, A_alpha_u_, A_, false);
+}
+
+GadgetPtr CMPConst_Gadget::create(ProtoboardPtr pb,
+                               const Variable& A,
+                               const unsigned long c,
+                               const bool isSigned,
+                               const bool orEqual,
+                               const bool constIsLhs,
+                               const Variable& result){
+    GadgetPtr pGadget(new CMPConst_Gadget(pb, A, c, isSigned, orEqual, constIsLhs, result));
+    pGadget->init();
+    return pGadget;
+}
+
+/*
+    Constraint breakdown (n = bitlen(c), bitlen(~c) for a negative signed c):
+
+    A_alpha_u_ = A.unpacked                                     (64 + 1)
+    hi = sum(A[i]), i >= n       (sum(1 - A[i]) for a negative c)
+    (1) hi * highInv = high                                     (1)
+    (2) hi * (1 - high) = 0                                     (1)
+    eq = 1 - high
+    gt = high                    unsigned
+         high - A[63]            signed, c >= 0
+         1 - A[63]               signed, c < 0
+    for i = n-1 .. 0:
+    (3) eq * A[i] = prod[i]                                     (n)
+        c[i] == 1 :  eq = prod[i]
+        c[i] == 0 :  gt = gt + prod[i], eq = eq - prod[i]
+    (4) result = gt | gt + eq | 1 - gt - eq | 1 - gt            (1)
+
+    For a signed c, bit 63 of A is one of the high bits: above bit n, c is all
+    zeros (c >= 0) or all ones (c < 0) up to and including its sign bit.
+*/
+void CMPConst_Gadget::generateConstraints()
+{
+    alphaDualVariablePacker1_->generateConstraints();
+
+    LinearCombination gt, eq;
+    if (bitlenc_ < BIT_SIZE) {
+        LinearCombination hi;
+        for (size_t i = bitlenc_; i < BIT_SIZE; i++) {
+            if (isNegative_)
+                hi += 1 - A_alpha_u_[i];
+            else
+                hi += A_alpha_u_[i];
+        }
+        addRank1Constraint(hi, highInv_, high_, GADGET_NAME("hi * highInv = high"));
+        addRank1Constraint(hi, 1 - high_, 0, GADGET_NAME("hi * (1 - high) = 0"));
+        eq = 1 - high_;
+        if (!isSigned_)
+            gt = high_;
+        else if (!isNegative_)
+            gt = high_ - A_alpha_u_[BIT_SIZE - 1];
+        else
+            gt = 1 - A_alpha_u_[BIT_SIZE - 1];
+    } else {
+        gt = 0;
+        eq = 1;
+    }
+
+    for (size_t i = bitlenc_; i-- > 0; ) {
+        addRank1Constraint(eq, A_alpha_u_[i], prod_[i], GADGET_NAME("eq * A[i] = prod[i]"));
+        if ((c_ >> i) & 1) {
+            eq = prod_[i];
+        } else {
+            gt += prod_[i];
+            eq -= prod_[i];
+        }
+    }
+
+    if (!constIsLhs_)
+        addRank1Constraint(orEqual_ ? gt + eq : gt, 1, result_, GADGET_NAME("cmp(A, c) * 1 = result"));
+    else
+        addRank1Constraint(orEqual_ ? 1 - gt : 1 - gt - eq, 1, result_, GADGET_NAME("cmp(c, A) * 1 = result"));
+}
+
+size_t CMPConst_Gadget::numConstraints() const
+{
+    return numConstraintsOf(alphaDualVariablePacker1_) + (bitlenc_ < BIT_SIZE ? 2 : 0) + bitlenc_ + 1;
+}
+
+void CMPConst_Gadget::generateWitness()
+{
+    alphaDualVariablePacker1_->generateWitness();
+
+    const unsigned long a = (unsigned long)(val(A_).asLong());
+    const long sign = (long)(a >> (BIT_SIZE - 1));
+
+    long gt = 0, eq = 1;
+    if (bitlenc_ < BIT_SIZE) {
+        const unsigned long bits = isNegative_ ? ~a : a;
+        long hi = 0;
+        for (size_t i = bitlenc_; i < BIT_SIZE; i++)
+            hi += (bits >> i) & 1;
+        val(high_) = (hi != 0 ? 1 : 0);
+        if (hi != 0)
+            setInverse(highInv_, FlatElem(hi));
+        else
+            val(highInv_) = 0;
+        eq = (hi != 0 ? 0 : 1);
+        if (!isSigned_)
+            gt = 1 - eq;
+        else if (!isNegative_)
+            gt = 1 - eq - sign;
+        else
+            gt = 1 - sign;
+    }
+
+    for (size_t i = bitlenc_; i-- > 0; ) {
+        long p = eq * ((a >> i) & 1);
+        val(prod_[i]) = p;
+        if ((c_ >> i) & 1) {
+            eq = p;
+        } else {
+            gt += p;
+            eq -= p;
+        }
+    }
+
+    if (!constIsLhs_)
+        val(result_) = (orEqual_ ? gt + eq : gt);
+    else
+        val(result_) = (orEqual_ ? 1 - gt : 1 - gt - eq);
+
+    DBG_MSG("!!! %ld = %ld %s %ld\n", val(result_).asLong(), constIsLhs_ ? (long)c_ : val(A_).asLong(),
+            orEqual_ ? ">=" : ">", constIsLhs_ ? val(A_).asLong() : (long)c_);
+}
+
+/*********************************/
+/***  END OF CMPConst_Gadget    ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                       EQConst_Gadget                       ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+EQConst_Gadget::EQConst_Gadget(ProtoboardPtr pb,
+                               const Variable& A,
+                               const long c,
+                               const bool isNeq,
+                               const Variable& result)
+    : Gadget(pb), A_(A), c_(c), isNeq_(isNeq), result_(result), aux_() {}
+
+void EQConst_Gadget::init() {}
+
+GadgetPtr EQConst_Gadget::create(ProtoboardPtr pb,
+                               const Variable& A,
+                               const long c,
+                               const bool isNeq,
+                               const Variable& result){
+    GadgetPtr pGadget(new EQConst_Gadget(pb, A, c, isNeq, result));
+    pGadget->init();
+    return pGadget;
+}
+
+/*
+    Constraint breakdown (EQ):
+    (1) (A - c) * result = 0
+    (2) (A - c) * aux = 1 - result
+
+    Constraint breakdown (NEQ):
+    (1) (A - c) * aux = result
+    (2) (A - c) * (1 - result) = 0
+
+    Both rows are needed: with (2) alone aux = 0 satisfies it for any A.
+*/
+void EQConst_Gadget::generateConstraints()
+{
+    if (!isNeq_) {
+        addRank1Constraint(A_ - c_, result_, 0, GADGET_NAME("(A - c) * result = 0"));
+        addRank1Constraint(A_ - c_, aux_, 1 - result_, GADGET_NAME("(A - c) * aux = 1 - result"));
+    } else {
+        addRank1Constraint(A_ - c_, aux_, result_, GADGET_NAME("(A - c) * aux = result"));
+        addRank1Constraint(A_ - c_, 1 - result_, 0, GADGET_NAME("(A - c) * (1 - result) = 0"));
+    }
+}
+
+size_t EQConst_Gadget::numConstraints() const
+{
+    return 2;
+}
+
+void EQConst_Gadget::generateWitness()
+{
+    const FlatElem diff = val(A_) - FlatElem(c_);
+    if (diff == 0)
+        val(aux_) = 0;
+    else
+        setInverse(aux_, diff);
+    if (!isNeq_)
+        val(result_) = (diff == 0 ? 1 : 0);
+    else
+        val(result_) = (diff != 0 ? 1 : 0);
+    DBG_MSG("!!! %ld = %ld %s %ld\n", val(result_).asLong(), val(A_).asLong(), isNeq_ ? "!=" : "==", c_);
+}
+
+/*********************************/
+/***   END OF EQConst_Gadget   ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                       POWMOD_Gadget                        ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+typedef unsigned __int128 uint128_t;
+
+/// field element of an unsigned 128 bit value, built from 32 bit limbs
+static FlatElem toFlatElem(uint128_t x)
+{
+    FlatElem result(0);
+    const FlatElem limb((long)1 << 32);
+    for (int i = 3; i >= 0; i--) {
+        result *= limb;
+        result += FlatElem((long)((x >> (32 * i)) & 0xFFFFFFFF));
+    }
+    return result;
+}
+
+static FElem toFElem(uint128_t x)
+{
+    return toFlatElem(x).asFElem();
+}
+
+/// sum of bits[i] * 2^i
+static LinearCombination packBits(const VariableArray& bits)
+{
+    LinearCombination result;
+    FElem coeff(1);
+    for (const auto& bit : bits) {
+        result += bit * coeff;
+        coeff += coeff;
+    }
+    return result;
+}
+
+POWMOD_Gadget::POWMOD_Gadget(ProtoboardPtr pb,
+                             const Variable& base,
+                             const Variable& exp,
+                             const Variable& mod,
+                             const Variable& result,
+                             const bool isExpConst,
+                             const unsigned long expConst,
+                             const bool isModConst,
+                             const unsigned long modConst)
+    : Gadget(pb), base_(base), exp_(exp), mod_(mod),
+      modIsZero_(GADGET_NAME("modIsZero")), modInv_(GADGET_NAME("modInv")), result_(result),
+      isExpConst_(isExpConst), expConst_(expConst), isModConst_(isModConst), modConst_(modConst),
+      modBits_(isModConst && modConst != 0 ? UDivisionConst_Gadget::bitLength(modConst) : BIT_SIZE),
+      numSteps_(numSteps(isExpConst, expConst)),
+      expBits_(isExpConst ? 0 : BIT_SIZE, GADGET_NAME("exp_bits")) {}
+
+size_t POWMOD_Gadget::numSteps(const bool isExpConst, const unsigned long expConst)
+{
+    if (!isExpConst)
+        return BIT_SIZE;
+    return expConst < 2 ? 0 : UDivisionConst_Gadget::bitLength(expConst) - 1;
+}
+
+/// whether the step multiplies by the base, the leading exponent bit is the start value
+bool POWMOD_Gadget::multiplies(size_t step) const
+{
+    return !isExpConst_ || ((expConst_ >> (numSteps_ - 1 - step)) & 1);
+}
+
+void POWMOD_Gadget::addReductionVariables(size_t qBits)
+{
+    qBits_.emplace_back(qBits, GADGET_NAME("q"));
+    rBits_.emplace_back(modBits_, GADGET_NAME("r"));
+    sBits_.emplace_back(isModConst_ && modConst_ == 0 ? 0 : modBits_, GADGET_NAME("s"));
+}
+
+void POWMOD_Gadget::init()
+{
+    // base < 2^64, so base / m fits on 64 - floor(log2 m) bits
+    if (!isModConst_)
+        addReductionVariables(BIT_SIZE);
+    else
+        addReductionVariables(modConst_ == 0 ? 0 : BIT_SIZE + 1 - modBits_);
+
+    // x ^ 0 = 1 mod m
+    if (isExpConst_ && expConst_ == 0)
+        addReductionVariables(1);
+
+    // u < m^2 for a square, u < m^3 with the base factor
+    for (size_t i = 0; i < numSteps_; i++) {
+        sq_.emplace_back(Variable(GADGET_NAME("sq")));
+        if (!isExpConst_)
+            f_.emplace_back(Variable(GADGET_NAME("f")));
+        if (multiplies(i))
+            u_.emplace_back(Variable(GADGET_NAME("u")));
+        addReductionVariables(multiplies(i) ? 2 * modBits_ : modBits_);
+    }
+}
+
+GadgetPtr POWMOD_Gadget::create(ProtoboardPtr pb,
+                                const Variable& base,
+                                const Variable& exp,
+                                const Variable& mod,
+                                const Variable& result,
+                                const bool isExpConst,
+                                const unsigned long expConst,
+                                const bool isModConst,
+                                const unsigned long modConst){
+    GadgetPtr pGadget(new POWMOD_Gadget(pb, base, exp, mod, result, isExpConst, expConst, isModConst, modConst));
+    pGadget->init();
+    return pGadget;
+}
+
+LinearCombination POWMOD_Gadget::modulus() const
+{
+    if (!isModConst_)
+        return mod_ + modIsZero_ * toFElem((uint128_t)1 << BIT_SIZE);
+    return toFElem(modConst_ == 0 ? (uint128_t)1 << BIT_SIZE : (uint128_t)modConst_);
+}
+
+/// unsigned value of a word operand, whose field value must be that word
+unsigned long POWMOD_Gadget::word(const Variable& var)
+{
+    const FlatRef ref = val(var);
+    const unsigned long w = (unsigned long)ref.asLong();
+    GADGETLIB_ASSERT(ref.hasWord() || FlatElem(ref) == FlatElem(w),
+                     "POWMOD_Gadget: operand is not an unsigned 64 bit word");
+    return w;
+}
+
+/// r entering a step, 1 for the first step of a variable exponent
+LinearCombination POWMOD_Gadget::accumulator(size_t step) const
+{
+    if (step == 0 && !isExpConst_)
+        return 1;
+    return packBits(rBits_[step]);
+}
+
+/*
+    Constraint breakdown of reduction k (n = bitlen(m), nq bits of q):
+    q, r, s bits are boolean                                    (nq + 2n)
+    q * m = u - r                                               (1)
+    m - 1 - r - s = 0  ==> r < m, omitted for m = 2^64          (1)
+    r, s < 2^n and q < 2^128 keep q * m + r below the field size.
+*/
+void POWMOD_Gadget::addReduction(size_t k, const LinearCombination& u)
+{
+    const LinearCombination r = packBits(rBits_[k]);
+    for (const auto& bit : qBits_[k])
+        enforceBooleanity(bit);
+    for (const auto& bit : rBits_[k])
+        enforceBooleanity(bit);
+    for (const auto& bit : sBits_[k])
+        enforceBooleanity(bit);
+
+    if (qBits_[k].empty())
+        addRank1Constraint(u - r, 1, 0, GADGET_NAME("u - r = 0"));
+    else
+        addRank1Constraint(packBits(qBits_[k]), modulus(), u - r, GADGET_NAME("q * m = u - r"));
+    if (!sBits_[k].empty())
+        addRank1Constraint(modulus() - 1 - r - packBits(sBits_[k]), 1, 0, GADGET_NAME("m - 1 - r - s = 0"));
+}
+
+/*
+    Constraint breakdown of a variable modulus (m' = m + 2^64 * zero):
+    m * zero = 0                                                (1)
+    m * mInv = 1 - zero                                         (1)
+
+    Constraint breakdown of step i (b is the reduced base):
+    r * r = sq                                                  (1)
+    exp_bit * (b - 1) = f - 1         (variable exponent)       (1)
+    sq * f = u  /  sq * b = u         (multiplying step)        (1)
+    reduction i + 1 of u  /  of sq
+*/
+void POWMOD_Gadget::generateConstraints()
+{
+    if (!isModConst_) {
+        addRank1Constraint(mod_, modIsZero_, 0, GADGET_NAME("m * zero = 0"));
+        addRank1Constraint(mod_, modInv_, 1 - modIsZero_, GADGET_NAME("m * mInv = 1 - zero"));
+    }
+    addReduction(0, base_);
+    const LinearCombination b = packBits(rBits_[0]);
+
+    if (!isExpConst_) {
+        for (const auto& bit : expBits_)
+            enforceBooleanity(bit);
+        addRank1Constraint(packBits(expBits_), 1, exp_, GADGET_NAME("exp_bits.packed = exp"));
+    }
+
+    if (isExpConst_ && expConst_ == 0)
+        addReduction(1, 1);
+
+    for (size_t i = 0, j = 0; i < numSteps_; i++) {
+        const LinearCombination r = accumulator(i);
+        addRank1Constraint(r, r, sq_[i], GADGET_NAME("r * r = sq"));
+        if (!isExpConst_) {
+            addRank1Constraint(expBits_[BIT_SIZE - 1 - i], b - 1, f_[i] - 1, GADGET_NAME("exp_bit * (b - 1) = f - 1"));
+            addRank1Constraint(sq_[i], f_[i], u_[j], GADGET_NAME("sq * f = u"));
+            addReduction(i + 1, u_[j++]);
+        } else if (multiplies(i)) {
+            addRank1Constraint(sq_[i], b, u_[j], GADGET_NAME("sq * b = u"));
+            addReduction(i + 1, u_[j++]);
+        } else {
+            addReduction(i + 1, sq_[i]);
+        }
+    }
+
+    const size_t last = (isExpConst_ && expConst_ == 0) ? 1 : numSteps_;
+    addRank1Constraint(packBits(rBits_[last]), 1, result_, GADGET_NAME("r * 1 = result"));
+}
+
+size_t POWMOD_Gadget::numConstraints() const
+{
+    // reductions: booleanity of the q, r, s bits, q * m = u - r, m - 1 - r - s = 0
+    size_t count = isModConst_ ? 0 : 2;
+    for (size_t k = 0; k < qBits_.size(); k++)
+        count += qBits_[k].size() + rBits_[k].size() + sBits_[k].size() + 1 + (sBits_[k].empty() ? 0 : 1);
+    if (!isExpConst_)
+        count += expBits_.size() + 1;
+    for (size_t i = 0; i < numSteps_; i++)
+        count += 1 + (!isExpConst_ ? 2 : (multiplies(i) ? 1 : 0));
+    return count + 1;
+}
+
+void POWMOD_Gadget::setReduction(size_t k, uint128_t q, uint128_t r, uint128_t m)
+{
+    for (size_t i = 0; i < qBits_[k].size(); i++)
+        val(qBits_[k][i]) = (long)((q >> i) & 1);
+    for (size_t i = 0; i < rBits_[k].size(); i++)
+        val(rBits_[k][i]) = (long)((r >> i) & 1);
+    for (size_t i = 0; i < sBits_[k].size(); i++)
+        val(sBits_[k][i]) = (long)(((m - 1 - r) >> i) & 1);
+}
+
+void POWMOD_Gadget::generateWitness()
+{
+    uint128_t m = isModConst_ ? (uint128_t)modConst_ : (uint128_t)word(mod_);
+    if (!isModConst_) {
+        val(modIsZero_) = (m == 0 ? 1 : 0);
+        if (m != 0)
+            setInverse(modInv_, FlatElem((unsigned long)m));
+        else
+            val(modInv_) = 0;
+    }
+    if (m == 0)
+        m = (uint128_t)1 << BIT_SIZE;
+    const unsigned long base = word(base_);
+    const unsigned long e = isExpConst_ ? expConst_ : word(exp_);
+
+    const uint128_t b = base % m;
+    setReduction(0, base / m, b, m);
+
+    if (!isExpConst_)
+        for (size_t i = 0; i < expBits_.size(); i++)
+            val(expBits_[i]) = (long)((e >> i) & 1);
+
+    uint128_t r = isExpConst_ ? b : 1;
+    if (isExpConst_ && expConst_ == 0) {
+        r = 1 % m;
+        setReduction(1, 1 / m, r, m);
+    }
+
+    for (size_t i = 0, j = 0; i < numSteps_; i++) {
+        const uint128_t sq = r * r;
+        val(sq_[i]) = toFlatElem(sq);
+
+        uint128_t f = 1;
+        if (!isExpConst_) {
+            f = ((e >> (BIT_SIZE - 1 - i)) & 1) ? b : 1;
+            val(f_[i]) = toFlatElem(f);
+        } else if (multiplies(i)) {
+            f = b;
+        }
+        if (multiplies(i)) {
+            FlatElem u = toFlatElem(sq);
+            u *= toFlatElem(f);
+            val(u_[j++]) = u;
+        }
+
+        // q = floor(sq * f / m) without leaving 128 bits, r, f < m
+        const uint128_t t = (sq % m) * f;
+        const uint128_t q = (sq / m) * f + t / m;
+        r = t % m;
+        setReduction(i + 1, q, r, m);
+    }
+
+    val(result_) = toFlatElem(r);
+#ifdef DEBUG
+    if (m >> BIT_SIZE)
+        printf("!!! %lu = %lu ^ %lu\n", (unsigned long)r, base, e);
+    else
+        printf("!!! %lu = %lu ^ %lu %% %lu\n", (unsigned long)r, base, e, (unsigned long)m);
+#endif
+}
+
+/*********************************/
+/***   END OF POWMOD_Gadget    ***/
+/*********************************/
+
+
 
 
 } // namespace gadgetlib2
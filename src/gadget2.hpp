@@ -8,19 +8,508 @@
 #ifndef LIBSNARK_GADGETLIB2_INCLUDE_GADGETLIB2_VCGADGET_HPP_
 #define LIBSNARK_GADGETLIB2_INCLUDE_GADGETLIB2_VCGADGET_HPP_
 
+#include <cstdint>
+#include <memory>
+#include <ostream>
 #include <vector>
 
+#include <libsnark/gadgetlib2/adapters.hpp>
 #include <libsnark/gadgetlib2/gadgetMacros.hpp>
 #include <libsnark/gadgetlib2/protoboard.hpp>
 #include <libsnark/gadgetlib2/variable.hpp>
 #include <libsnark/gadgetlib2/gadget.hpp>
 
+#include "witnessApi.h"
 
 #define WORD_BIT_SIZE  (sizeof(long) * 8)
 
+/// Constraint annotation / variable name. Building with CSNARK_NO_ANNOTATIONS
+/// compiles them out; otherwise gadgetlib2::setAnnotations(false) skips them at
+/// run time. The string expression is not evaluated when it is dropped.
+#ifdef CSNARK_NO_ANNOTATIONS
+#define GADGET_NAME(str) ::std::string()
+#else
+#define GADGET_NAME(str) (::gadgetlib2::annotationsEnabled() ? ::std::string(str) : ::std::string())
+#endif
+
 
 namespace gadgetlib2
 {
+/// run time switch of GADGET_NAME, on by default
+void setAnnotations(bool enable);
+bool annotationsEnabled();
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                      FlatElem classes                      ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// R1P field element stored inline (libff::Fr in Montgomery form). Unlike
+/// FElem it holds no heap allocated FElemInterface, so witness arithmetic does
+/// not allocate or dispatch. Convert with asFElem() / FlatElem(FElem) only
+/// where gadgetlib2 needs its own type.
+class FlatElem
+{
+  public:
+    FlatElem() : elem_(Fp::zero()) {}
+    FlatElem(const int n) : elem_((long)n) {}
+    FlatElem(const long n) : elem_(n) {}
+    FlatElem(const unsigned long n) : elem_((long)n, true) {}
+    explicit FlatElem(const Fp& elem) : elem_(elem) {}
+    explicit FlatElem(const FElem& elem) : elem_(GadgetLibAdapter().convert(elem)) {}
+
+    const Fp& asFp() const {return elem_;}
+    FElem asFElem() const {return FElem(elem_);}
+    /// low 64 bits, as FElem::asLong
+    long asLong() const {return long(elem_.as_ulong());}
+    FlatElem inverse() const {return FlatElem(elem_.inverse());}
+
+    FlatElem& operator+=(const FlatElem& other) {elem_ += other.elem_; return *this;}
+    FlatElem& operator-=(const FlatElem& other) {elem_ -= other.elem_; return *this;}
+    FlatElem& operator*=(const FlatElem& other) {elem_ *= other.elem_; return *this;}
+
+  private:
+    Fp elem_;
+};
+
+inline FlatElem operator+(FlatElem first, const FlatElem& second) {return first += second;}
+inline FlatElem operator-(FlatElem first, const FlatElem& second) {return first -= second;}
+inline FlatElem operator*(FlatElem first, const FlatElem& second) {return first *= second;}
+inline bool operator==(const FlatElem& first, const FlatElem& second) {return first.asFp() == second.asFp();}
+inline bool operator!=(const FlatElem& first, const FlatElem& second) {return first.asFp() != second.asFp();}
+
+/// One variable of a DenseProtoboard. Non-negative integers are kept as a
+/// native 64 bit shadow, read as a field element through field() and only
+/// stored as one by DenseProtoboard::materialize. Reads never write the slot,
+/// so gadgets of one witness level may share their inputs across threads.
+struct DenseSlot
+{
+    enum State : unsigned char {
+        FIELD,  // elem only
+        WORD,   // word only, elem stale
+        BOTH,   // elem == word
+        INVERSE // value is elem^-1, queued until DenseProtoboard::resolveInverses
+    };
+
+    FlatElem elem;
+    uint64_t word;
+    State state;
+
+    DenseSlot() : word(0), state(BOTH) {}
+
+    bool hasWord() const {return state == WORD || state == BOTH;}
+    FlatElem field() const {return state == WORD ? FlatElem((unsigned long)word) : elem;}
+    void materialize() {
+        if (state == WORD) {
+            elem = FlatElem((unsigned long)word);
+            state = BOTH;
+        }
+    }
+    void setWord(uint64_t value) {word = value; state = WORD;}
+    void setField(const FlatElem& value) {elem = value; state = FIELD;}
+};
+
+/// Reference returned by DenseGadget::val: a DenseSlot of a DenseProtoboard, or
+/// the FElem of a plain Protoboard converted on each access. Integer reads and
+/// writes stay on the slot's 64 bit shadow. The slot is held by index, the
+/// vector may grow while a reference is alive.
+class FlatRef
+{
+  public:
+    FlatRef(::std::vector<DenseSlot>& slots, size_t index) : slots_(&slots), index_(index), elem_(NULL) {}
+    explicit FlatRef(FElem& elem) : slots_(NULL), index_(0), elem_(&elem) {}
+
+    operator FlatElem() const {return slots_ ? slot().field() : FlatElem(*elem_);}
+    bool hasWord() const {return slots_ && slot().hasWord();}
+    /// low 64 bits, as FElem::asLong
+    long asLong() const {
+        if (!slots_)
+            return elem_->asLong();
+        return slot().hasWord() ? (long)slot().word : slot().elem.asLong();
+    }
+
+    FlatRef& operator=(const FlatElem& value) {
+        if (slots_)
+            slot().setField(value);
+        else
+            *elem_ = value.asFElem();
+        return *this;
+    }
+    FlatRef& operator=(const int n) {return *this = (long)n;}
+    FlatRef& operator=(const long n) {
+        if (n < 0)
+            return *this = FlatElem(n);
+        if (slots_)
+            slot().setWord((uint64_t)n);
+        else
+            *elem_ = n;
+        return *this;
+    }
+    FlatRef& operator=(const unsigned long n) {
+        if (slots_)
+            slot().setWord(n);
+        else
+            *elem_ = FElem((size_t)n);
+        return *this;
+    }
+    FlatRef& operator=(const FlatRef& other) {
+        if (slots_ && other.hasWord())
+            slot().setWord(other.slot().word);
+        else
+            *this = FlatElem(other);
+        return *this;
+    }
+
+  private:
+    DenseSlot& slot() const {return (*slots_)[index_];}
+
+    ::std::vector<DenseSlot>* const slots_;
+    const size_t index_;
+    FElem* const elem_;
+};
+
+inline bool operator==(const FlatRef& first, const long second) {
+    if (first.hasWord() && second >= 0)
+        return first.asLong() == second;
+    return FlatElem(first) == FlatElem(second);
+}
+inline bool operator!=(const FlatRef& first, const long second) {return !(first == second);}
+inline bool operator==(const FlatRef& first, const FlatRef& second) {
+    if (first.hasWord() && second.hasWord())
+        return first.asLong() == second.asLong();
+    return FlatElem(first) == FlatElem(second);
+}
+inline bool operator!=(const FlatRef& first, const FlatRef& second) {return !(first == second);}
+
+/// Witness arithmetic of the simple gadgets, shared with WitnessTape. The
+/// operands are read before result is written, so result may alias one.
+inline void addWitness(FlatRef result, const FlatRef& lhs, const FlatRef& rhs) {
+    uint64_t sum;
+    if (lhs.hasWord() && rhs.hasWord() &&
+        !__builtin_add_overflow((uint64_t)lhs.asLong(), (uint64_t)rhs.asLong(), &sum))
+        result = (unsigned long)sum;
+    else
+        result = lhs + rhs;
+}
+inline void subWitness(FlatRef result, const FlatRef& lhs, const FlatRef& rhs) {
+    if (lhs.hasWord() && rhs.hasWord() && (uint64_t)lhs.asLong() >= (uint64_t)rhs.asLong())
+        result = (unsigned long)((uint64_t)lhs.asLong() - (uint64_t)rhs.asLong());
+    else
+        result = lhs - rhs;
+}
+inline void logicWitness(FlatRef result, const FlatRef& A, const FlatRef& B, const bool isOr) {
+    const bool a = A.asLong() != 0;
+    const bool b = B.asLong() != 0;
+    result = (isOr ? (a || b) : (a && b)) ? 1 : 0;
+}
+/*********************************/
+/***     END OF FlatElem       ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                  DenseProtoboard classes                   ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// Rank-1 constraints A * B = C as three sparse matrices in CSR form: row r of a
+/// matrix is cols/coeffs[rowStart[r] .. rowStart[r + 1]). Columns are libsnark
+/// variable indexes, 0 for the constant ONE and gadgetlib2 index + 1 otherwise.
+/// Each row holds the terms of the gadgetlib2 LinearCombination followed by
+/// its constant term; row() gives back what GadgetLibAdapter::convert would.
+class SparseR1CS
+{
+  public:
+    struct Matrix {
+        ::std::vector<size_t> rowStart;
+        ::std::vector<size_t> cols;
+        ::std::vector<Fp> coeffs;
+
+        Matrix() : rowStart(1, 0) {}
+        void addRow(const GadgetLibAdapter::linear_combination_t& lc);
+        GadgetLibAdapter::linear_combination_t row(size_t r) const;
+        /// row . assignment, column 0 being ONE and column i value(i - 1)
+        template<typename ValueOf>
+        Fp evalRow(size_t row, const ValueOf& value) const;
+    };
+
+    void addConstraint(const LinearCombination& a, const LinearCombination& b,
+                       const LinearCombination& c);
+    size_t numConstraints() const {return A.rowStart.size() - 1;}
+    /// distinct variables (ONE excluded) used by the first rows constraints
+    size_t countUsedVariables(size_t rows) const;
+    /// hash of the columns of constraint row; equal constraints hash equal
+    size_t hashRow(size_t row) const;
+    /// constraints r and s have the same terms in the same order
+    bool sameRow(size_t r, size_t s) const;
+    void clear() {A = B = C = Matrix();}
+
+    Matrix A, B, C;
+};
+
+template<typename ValueOf>
+Fp SparseR1CS::Matrix::evalRow(size_t row, const ValueOf& value) const
+{
+    Fp result = Fp::zero();
+    for (size_t k = rowStart[row]; k < rowStart[row + 1]; k++)
+        result += cols[k] == 0 ? coeffs[k] : coeffs[k] * value(cols[k] - 1);
+    return result;
+}
+
+/// Protoboard keeping the assignment in a vector of DenseSlot indexed by the
+/// variable index instead of gadgetlib2's std::map. Gadgets derived from DenseGadget read and
+/// write it directly; call flush() before using the gadgetlib2 assignment
+/// (isSatisfied, get_variable_assignment_from_gadgetlib2). A direct mode
+/// build has no gadgetlib2 constraints, so flush() leaves that assignment empty.
+/// R1P_MIN_Gadget evaluates through gadgetlib2's Comparison_Gadget and only
+/// works on a plain Protoboard; it also adds its constraints directly, so it
+/// must not be used under a Recorder or in direct mode.
+/// In direct mode (setDirect) the constraints of the DenseGadgets are written
+/// straight to a SparseR1CS instead of gadgetlib2 Constraint objects.
+class DenseProtoboard : public Protoboard
+{
+  protected:
+    explicit DenseProtoboard(const FieldType& fieldType);
+
+  public:
+    static ProtoboardPtr create(const FieldType& fieldType);
+    /// pb as a DenseProtoboard, NULL for a plain Protoboard. gadgetlib2's
+    /// Protoboard has no virtual function to dynamic_cast on, its polymorphic
+    /// params carry the type instead.
+    static DenseProtoboard* find(const ProtoboardPtr& pb) {
+        return pb && dynamic_cast<const Params*>(pb->params().get()) ? static_cast<DenseProtoboard*>(pb.get()) : NULL;
+    }
+
+    FlatRef val(const Variable& var);
+    FlatElem val(const LinearCombination& lc);
+    /// slot of a variable already tracked by val(), by gadgetlib2 index
+    FlatRef at(size_t index);
+    /// var := x^-1 for a non-zero x. The inversions are queued (one queue per
+    /// OpenMP thread) and done together by resolveInverses, one field
+    /// inversion for the whole batch.
+    void setInverse(const Variable& var, const FlatElem& x);
+    void resolveInverses();
+    /// size the slots for every variable allocated so far and the inverse
+    /// queues for the current thread count, and resolve the inversions still
+    /// queued. Call before generating witnesses in parallel: afterwards val()
+    /// only touches the slot it is asked for.
+    void reserve();
+
+    /// index of bits[0] if bits holds consecutive variables (as allocated by
+    /// VariableArray(size, name)), -1 otherwise
+    static long firstIndexOf(const VariableArray& bits);
+    /// bits[i] := (word >> i) & 1, bits consecutive from first, at most 64 bits
+    void setBits(const VariableArray& bits, size_t first, uint64_t word);
+    /// word := sum bits[i] << i; false if a bit is not a 0/1 integer
+    bool getBits(const VariableArray& bits, size_t first, uint64_t& word);
+    /// resolve the queued inversions and turn every 64 bit shadow into its
+    /// field element
+    void materialize();
+    /// copy the values of the variables used by the gadgetlib2 constraint
+    /// system into its assignment
+    void flush();
+    /// One constraint recorded by a Recorder: a rank-1 constraint, or the
+    /// booleanity of boolVar when it is set.
+    struct RecordedConstraint {
+        LinearCombination a, b, c;
+        ::std::string name;
+        ::std::unique_ptr<Variable> boolVar;
+    };
+    typedef ::std::vector<RecordedConstraint> ConstraintBuffer;
+
+    /// While a Recorder is alive, the constraints its thread adds through
+    /// DenseGadget go to buffer instead of the constraint system. Gadgets can
+    /// then generate their constraints in parallel, one buffer each, and
+    /// replay() the buffers in gadget order: the R1CS is the same as a serial
+    /// build. Gadgets must not allocate variables in generateConstraints.
+    class Recorder {
+      public:
+        explicit Recorder(ConstraintBuffer& buffer) : prev_(recording_) {recording_ = &buffer;}
+        ~Recorder() {recording_ = prev_;}
+      private:
+        ConstraintBuffer* const prev_;
+        DISALLOW_COPY_AND_ASSIGN(Recorder);
+    };
+
+    void addRank1Constraint(const LinearCombination& a,
+                            const LinearCombination& b,
+                            const LinearCombination& c,
+                            const ::std::string& name);
+    void enforceBooleanity(const Variable& var);
+    /// append the recorded constraints to the constraint system, in order
+    void replay(const ConstraintBuffer& buffer);
+
+    /// send the constraints added from now on to sparseR1CS()
+    void setDirect(bool direct) {direct_ = direct;}
+    bool isDirect() const {return direct_;}
+    const SparseR1CS& sparseR1CS() const {return sparse_;}
+    /// the dense values satisfy the constraints of sparseR1CS() and, after a
+    /// flush(), of the gadgetlib2 constraint system
+    bool isSatisfied(const PrintOptions& printOnFail = PrintOptions::NO_DBG_PRINT);
+
+    /// number of slots, indexed by gadgetlib2 variable index
+    size_t size() const {return values_.size();}
+    /// field value of a slot, valid after materialize(); unused entries are zero
+    const FlatElem& value(size_t index) const {
+        GADGETLIB_ASSERT(values_[index].state == DenseSlot::FIELD || values_[index].state == DenseSlot::BOTH,
+                         "DenseProtoboard::value before materialize");
+        return values_[index].elem;
+    }
+
+  private:
+    struct Params : public ProtoboardParams {};
+
+    void track(size_t index);
+    void emit(const LinearCombination& a, const LinearCombination& b,
+              const LinearCombination& c, const ::std::string& name);
+    void emitBooleanity(const Variable& var);
+
+    ::std::vector<DenseSlot> values_;
+    ::std::vector<char> tracked_;                        // index has a value, char: written by parallel witnesses
+    ::std::vector< ::std::vector<size_t> > inverses_;    // slots in state INVERSE, per thread
+    bool direct_;
+    SparseR1CS sparse_;
+
+    static thread_local ConstraintBuffer* recording_;
+    DISALLOW_COPY_AND_ASSIGN(DenseProtoboard);
+};
+
+inline FlatRef DenseProtoboard::val(const Variable& var)
+{
+    const size_t index = GadgetLibAdapter::getVariableIndex(var);
+    if (index >= tracked_.size() || !tracked_[index])
+        track(index);
+    else if (values_[index].state == DenseSlot::INVERSE)
+        resolveInverses();
+    return FlatRef(values_, index);
+}
+
+inline FlatRef DenseProtoboard::at(size_t index)
+{
+    if (values_[index].state == DenseSlot::INVERSE)
+        resolveInverses();
+    return FlatRef(values_, index);
+}
+
+/// Witness operation of a gadget for WitnessTape: result first in vars, then
+/// the operands.
+struct TapeOp {
+    enum Opcode : uint8_t {GADGET, ADD, SUB, MUL, MULCONST, AND, OR};
+
+    Opcode opcode;
+    const Variable* vars[3];
+    long constant;
+};
+
+/// Base of the libcsnark gadgets: val() goes to the DenseProtoboard the gadget
+/// was created on, or to the gadgetlib2 assignment on a plain Protoboard.
+/// Gadget is a virtual base, so the gadget's own Gadget(pb) initializer is the
+/// one that runs.
+class DenseGadget : virtual public Gadget
+{
+  protected:
+    DenseGadget() : Gadget(ProtoboardPtr()), densePb_(DenseProtoboard::find(pb_)) {}
+
+    /// the DenseProtoboard of the gadget, NULL on a plain Protoboard
+    DenseProtoboard* densePb() const {return densePb_;}
+
+  public:
+    FlatRef val(const Variable& var) {
+        return densePb_ ? densePb_->val(var) : FlatRef(pb_->val(var));
+    }
+    FlatElem val(const LinearCombination& lc) {
+        return densePb_ ? densePb_->val(lc) : FlatElem(pb_->val(lc));
+    }
+    /// var := x^-1, batched on a DenseProtoboard; x must not be zero
+    void setInverse(const Variable& var, const FlatElem& x) {
+        if (densePb_)
+            densePb_->setInverse(var, x);
+        else
+            pb_->val(var) = x.inverse().asFElem();
+    }
+    /// constraints go through the DenseProtoboard so that they can be
+    /// recorded. R1P_Gadget declares its own addRank1Constraint, so the R1P
+    /// gadgets pick this one with a using-declaration.
+    void addRank1Constraint(const LinearCombination& a,
+                            const LinearCombination& b,
+                            const LinearCombination& c,
+                            const ::std::string& name) {
+        if (densePb_)
+            densePb_->addRank1Constraint(a, b, c, name);
+        else
+            pb_->addRank1Constraint(a, b, c, name);
+    }
+    void enforceBooleanity(const Variable& var) {
+        if (densePb_)
+            densePb_->enforceBooleanity(var);
+        else
+            pb_->enforceBooleanity(var);
+    }
+
+    /// number of rows generateConstraints adds, without adding them; the
+    /// constraints of a dead gadget are counted this way, never generated
+    virtual size_t numConstraints() const = 0;
+
+  protected:
+    /// describe generateWitness as a single TapeOp; false (the default) if it
+    /// is not one, WitnessTape then calls generateWitness
+    virtual bool tapeOp(TapeOp&) const {return false;}
+    /// numConstraints of a sub-gadget, which must be a DenseGadget
+    static size_t numConstraintsOf(const GadgetPtr& gadget);
+
+  private:
+    DenseProtoboard* const densePb_;
+    friend class WitnessTape;
+};
+
+/// Witness generation as a flat op tape, one entry per appended gadget, kept
+/// as a struct of arrays (opcode, slot indexes, constant). The simple ops run
+/// in a switch straight on the DenseProtoboard slots with the arithmetic of
+/// their gadget, without the virtual call or the trace; the others fall back to
+/// the gadget's generateWitness. The gadgets remain the constraint backend.
+class WitnessTape
+{
+  public:
+    /// append the op of gadget and track its slots on pb
+    void append(DenseProtoboard& pb, const GadgetPtr& gadget);
+    /// generateWitness of the i-th appended gadget
+    void run(DenseProtoboard& pb, size_t i) const;
+    size_t size() const {return opcodes_.size();}
+    void clear();
+
+    /// Write the C++ source of `extern "C" void symbol(...)` (a Witness_Func)
+    /// running the live ops in order: the simple ones as straight-line 64 bit
+    /// code on the slot words, falling back to run() when an operand is not a
+    /// word or the result leaves the word range, the others through run().
+    /// symbol_ops and symbol_live hold the tape size and live op count,
+    /// symbol_hash the hash() of the tape it was generated from.
+    void emitCode(::std::ostream& out, const ::std::string& symbol,
+                  const ::std::vector<bool>& live) const;
+    /// FNV-1a of every op (opcode, slots, constant) and its liveness: a
+    /// function from emitCode only runs on a tape with the same hash
+    uint64_t hash(const ::std::vector<bool>& live) const;
+    /// run a function generated by emitCode for this tape on pb
+    void runCompiled(DenseProtoboard& pb, Witness_Func func) const;
+
+  private:
+    ::std::vector<uint8_t> opcodes_;
+    ::std::vector<size_t> out_;
+    ::std::vector<size_t> in0_;
+    ::std::vector<size_t> in1_;
+    ::std::vector<long> constants_;
+    ::std::vector<GadgetPtr> gadgets_; // for TapeOp::GADGET
+};
+/*********************************/
+/***  END OF DenseProtoboard   ***/
+/*********************************/
+
+
 /*************************************************************************************************/
 /*************************************************************************************************/
 /*******************                                                            ******************/
@@ -29,16 +518,19 @@ namespace gadgetlib2
 /*************************************************************************************************/
 /*************************************************************************************************/
 CREATE_GADGET_BASE_CLASS(ADD_GadgetBase);
-class R1P_ADD_Gadget : public ADD_GadgetBase, public R1P_Gadget
+class R1P_ADD_Gadget : public ADD_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_ADD_Gadget(ProtoboardPtr pb, const Variable& A, const Variable& B,
                    const Variable& result);
     virtual void init();
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
+    bool tapeOp(TapeOp& op) const;
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
                             const Variable& B,
@@ -60,16 +552,19 @@ CREATE_GADGET_FACTORY_CLASS_3(ADD_Gadget,
 
 
 CREATE_GADGET_BASE_CLASS(SUB_GadgetBase);
-class R1P_SUB_Gadget : public SUB_GadgetBase, public R1P_Gadget
+class R1P_SUB_Gadget : public SUB_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_SUB_Gadget(ProtoboardPtr pb, const Variable& A, const Variable& B,
                    const Variable& result);
     virtual void init();
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
+    bool tapeOp(TapeOp& op) const;
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
                             const Variable& B,
@@ -92,15 +587,17 @@ CREATE_GADGET_FACTORY_CLASS_3(SUB_Gadget,
 
 
 CREATE_GADGET_BASE_CLASS(NOT_GadgetBase);
-class R1P_NOT_Gadget : public NOT_GadgetBase, public R1P_Gadget
+class R1P_NOT_Gadget : public NOT_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_NOT_Gadget(ProtoboardPtr pb, const Variable& A,
                    const Variable& result);
     virtual void init();
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -123,9 +620,10 @@ CREATE_GADGET_FACTORY_CLASS_2(NOT_Gadget,
 
 CREATE_GADGET_BASE_CLASS(MUL_GadgetBase);
 
-class R1P_MUL_Gadget : public MUL_GadgetBase, public R1P_Gadget
+class R1P_MUL_Gadget : public MUL_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_MUL_Gadget(ProtoboardPtr pb, const Variable& A,
                             const Variable& B,
                             const Variable& result);
@@ -133,7 +631,9 @@ class R1P_MUL_Gadget : public MUL_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
+    bool tapeOp(TapeOp& op) const;
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
                             const Variable& B,
@@ -213,9 +713,10 @@ CREATE_GADGET_FACTORY_CLASS_4(MIN_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(SREM_GadgetBase);
 
-class R1P_SREM_Gadget : public SREM_GadgetBase, public R1P_Gadget
+class R1P_SREM_Gadget : public SREM_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_SREM_Gadget(ProtoboardPtr pb, const Variable& A,
                             const Variable& B,
                             const Variable& result);
@@ -223,6 +724,7 @@ class R1P_SREM_Gadget : public SREM_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -265,9 +767,10 @@ CREATE_GADGET_FACTORY_CLASS_3(SREM_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(SDIV_GadgetBase);
 
-class R1P_SDIV_Gadget : public SDIV_GadgetBase, public R1P_Gadget
+class R1P_SDIV_Gadget : public SDIV_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_SDIV_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const Variable& B,
@@ -276,6 +779,7 @@ class R1P_SDIV_Gadget : public SDIV_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -316,9 +820,10 @@ CREATE_GADGET_FACTORY_CLASS_3(SDIV_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(UREM_GadgetBase);
 
-class R1P_UREM_Gadget : public UREM_GadgetBase, public R1P_Gadget
+class R1P_UREM_Gadget : public UREM_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_UREM_Gadget(ProtoboardPtr pb, const Variable& A,
                             const Variable& B,
                             const Variable& R);
@@ -326,6 +831,7 @@ class R1P_UREM_Gadget : public UREM_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -366,9 +872,10 @@ CREATE_GADGET_FACTORY_CLASS_3(UREM_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(UDIV_GadgetBase);
 
-class R1P_UDIV_Gadget : public UDIV_GadgetBase, public R1P_Gadget
+class R1P_UDIV_Gadget : public UDIV_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_UDIV_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const Variable& B,
@@ -377,6 +884,7 @@ class R1P_UDIV_Gadget : public UDIV_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -414,9 +922,10 @@ CREATE_GADGET_FACTORY_CLASS_3(UDIV_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(BITWISE_OR_GadgetBase);
 
-class R1P_BITWISE_OR_Gadget : public BITWISE_OR_GadgetBase, public R1P_Gadget
+class R1P_BITWISE_OR_Gadget : public BITWISE_OR_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_BITWISE_OR_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const Variable& B,
@@ -425,6 +934,7 @@ class R1P_BITWISE_OR_Gadget : public BITWISE_OR_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -469,9 +979,10 @@ CREATE_GADGET_FACTORY_CLASS_3(BITWISE_OR_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(BITWISE_XOR_GadgetBase);
 
-class R1P_BITWISE_XOR_Gadget : public BITWISE_XOR_GadgetBase, public R1P_Gadget
+class R1P_BITWISE_XOR_Gadget : public BITWISE_XOR_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_BITWISE_XOR_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const Variable& B,
@@ -480,6 +991,7 @@ class R1P_BITWISE_XOR_Gadget : public BITWISE_XOR_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -524,9 +1036,10 @@ CREATE_GADGET_FACTORY_CLASS_3(BITWISE_XOR_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(BITWISE_AND_GadgetBase);
 
-class R1P_BITWISE_AND_Gadget : public BITWISE_AND_GadgetBase, public R1P_Gadget
+class R1P_BITWISE_AND_Gadget : public BITWISE_AND_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_BITWISE_AND_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const Variable& B,
@@ -535,6 +1048,7 @@ class R1P_BITWISE_AND_Gadget : public BITWISE_AND_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -579,9 +1093,10 @@ CREATE_GADGET_FACTORY_CLASS_3(BITWISE_AND_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(TRUNC_GadgetBase);
 
-class R1P_TRUNC_Gadget : public TRUNC_GadgetBase, public R1P_Gadget
+class R1P_TRUNC_Gadget : public TRUNC_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_TRUNC_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const size_t &srcSize,
@@ -591,6 +1106,7 @@ class R1P_TRUNC_Gadget : public TRUNC_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                           const Variable& A,
@@ -635,9 +1151,10 @@ CREATE_GADGET_FACTORY_CLASS_4(TRUNC_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(ZEXT_GadgetBase);
 
-class R1P_ZEXT_Gadget : public ZEXT_GadgetBase, public R1P_Gadget
+class R1P_ZEXT_Gadget : public ZEXT_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_ZEXT_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const size_t &srcSize,
@@ -647,6 +1164,7 @@ class R1P_ZEXT_Gadget : public ZEXT_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -690,9 +1208,10 @@ CREATE_GADGET_FACTORY_CLASS_4(ZEXT_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(SEXT_GadgetBase);
 
-class R1P_SEXT_Gadget : public SEXT_GadgetBase, public R1P_Gadget
+class R1P_SEXT_Gadget : public SEXT_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_SEXT_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const size_t &srcSize,
@@ -702,6 +1221,7 @@ class R1P_SEXT_Gadget : public SEXT_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -746,9 +1266,10 @@ CREATE_GADGET_FACTORY_CLASS_4(SEXT_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(EQ_GadgetBase);
 
-class R1P_EQ_Gadget : public EQ_GadgetBase, public R1P_Gadget
+class R1P_EQ_Gadget : public EQ_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_EQ_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const Variable& B,
@@ -757,6 +1278,7 @@ class R1P_EQ_Gadget : public EQ_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -794,9 +1316,10 @@ CREATE_GADGET_FACTORY_CLASS_3(EQ_Gadget, // TODO uncomment this
 // TODO create unit test
 CREATE_GADGET_BASE_CLASS(NEQ_GadgetBase);
 
-class R1P_NEQ_Gadget : public NEQ_GadgetBase, public R1P_Gadget
+class R1P_NEQ_Gadget : public NEQ_GadgetBase, public R1P_Gadget, public DenseGadget
 {
   private:
+    using DenseGadget::addRank1Constraint; // hides R1P_Gadget's, see DenseGadget
     R1P_NEQ_Gadget(ProtoboardPtr pb,
                   const Variable& A,
                   const Variable& B,
@@ -805,6 +1328,7 @@ class R1P_NEQ_Gadget : public NEQ_GadgetBase, public R1P_Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -840,7 +1364,7 @@ CREATE_GADGET_FACTORY_CLASS_3(NEQ_Gadget, // TODO uncomment this
 /*************************************************************************************************/
 /*************************************************************************************************/
 
-class SGT_Gadget : public Gadget
+class SGT_Gadget : public DenseGadget
 {
   private:
     SGT_Gadget(ProtoboardPtr pb,
@@ -851,6 +1375,7 @@ class SGT_Gadget : public Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -884,7 +1409,7 @@ class SGT_Gadget : public Gadget
 /*************************************************************************************************/
 /*************************************************************************************************/
 
-class SGE_Gadget : public Gadget
+class SGE_Gadget : public DenseGadget
 {
   private:
     SGE_Gadget(ProtoboardPtr pb,
@@ -895,6 +1420,7 @@ class SGE_Gadget : public Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -927,7 +1453,7 @@ class SGE_Gadget : public Gadget
 /*************************************************************************************************/
 /*************************************************************************************************/
 
-class UGT_Gadget : public Gadget
+class UGT_Gadget : public DenseGadget
 {
   private:
     UGT_Gadget(ProtoboardPtr pb,
@@ -938,6 +1464,7 @@ class UGT_Gadget : public Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -980,7 +1507,7 @@ class UGT_Gadget : public Gadget
 /*************************************************************************************************/
 /*************************************************************************************************/
 
-class UGE_Gadget : public Gadget
+class UGE_Gadget : public DenseGadget
 {
   private:
     UGE_Gadget(ProtoboardPtr pb,
@@ -991,6 +1518,7 @@ class UGE_Gadget : public Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -1030,7 +1558,7 @@ class UGE_Gadget : public Gadget
 /// If toggle is 1, oneValue --> result
 /// Uses 1 constraint
 
-class Select_Gadget : public Gadget {
+class Select_Gadget : public DenseGadget {
 private:
     FlagVariable toggle_;
     LinearCombination zeroValue_;
@@ -1053,6 +1581,7 @@ public:
                             const Variable& result);
 
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
 };
 
@@ -1060,6 +1589,52 @@ public:
 /***       END OF Gadget       ***/
 /*********************************/
 
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                        LOGIC_Gadget                        ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// Binary logic and / or of two boolean variables, the DenseGadget counterpart
+/// of gadgetlib2's AND_Gadget / OR_Gadget.
+/// and: A * B = result
+/// or:  A * B = A + B - result
+/// Uses 1 constraint, the inputs are not checked for booleanity.
+
+class LOGIC_Gadget : public DenseGadget {
+private:
+    const Variable A_;
+    const Variable B_;
+    const bool isOr_;
+    const Variable result_;
+
+    LOGIC_Gadget(ProtoboardPtr pb,
+                 const Variable& A,
+                 const Variable& B,
+                 bool isOr,
+                 const Variable& result);
+
+    virtual void init() {}
+    DISALLOW_COPY_AND_ASSIGN(LOGIC_Gadget);
+public:
+    static GadgetPtr create(ProtoboardPtr pb,
+                            const Variable& A,
+                            const Variable& B,
+                            bool isOr,
+                            const Variable& result);
+
+    void generateConstraints();
+    size_t numConstraints() const;
+    void generateWitness();
+    bool tapeOp(TapeOp& op) const;
+};
+
+/*********************************/
+/***    END OF LOGIC_Gadget    ***/
+/*********************************/
+
 /*************************************************************************************************/
 /*************************************************************************************************/
 /*******************                                                            ******************/
@@ -1068,11 +1643,12 @@ public:
 /*************************************************************************************************/
 /*************************************************************************************************/
 
-class Packing_Gadget : public Gadget {
+class Packing_Gadget : public DenseGadget {
 private:
     VariableArray unpacked_;
     Variable packed_;
     bool ispacking;
+    const long firstBit_; // DenseProtoboard::firstIndexOf(unpacked_)
 
     Packing_Gadget(ProtoboardPtr pb,
                    const VariableArray& unpacked,
@@ -1089,6 +1665,7 @@ public:
                        bool ispacking);
 
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
 };
 
@@ -1104,7 +1681,7 @@ public:
 /*************************************************************************************************/
 /*************************************************************************************************/
 
-class GETBIT_Gadget : public Gadget
+class GETBIT_Gadget : public DenseGadget
 {
   private:
     GETBIT_Gadget(ProtoboardPtr pb,
@@ -1115,6 +1692,7 @@ class GETBIT_Gadget : public Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -1147,7 +1725,7 @@ class GETBIT_Gadget : public Gadget
 /*************************************************************************************************/
 /*************************************************************************************************/
 
-class UDivision_Gadget: public Gadget
+class UDivision_Gadget: public DenseGadget
 {
   private:
     UDivision_Gadget(ProtoboardPtr pb, 
@@ -1159,6 +1737,7 @@ class UDivision_Gadget: public Gadget
 
   public:
     void generateConstraints();
+    size_t numConstraints() const;
     void generateWitness();
     static GadgetPtr create(ProtoboardPtr pb,
                             const Variable& A,
@@ -1184,6 +1763,312 @@ class UDivision_Gadget: public Gadget
 /*********************************/
 
 
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                  MULConst_Gadget classes                   ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// result = A * c for a constant c known when the circuit is built.
+/// Uses 1 linear constraint instead of a rank-1 product.
+class MULConst_Gadget : public DenseGadget
+{
+  private:
+    MULConst_Gadget(ProtoboardPtr pb,
+                  const Variable& A,
+                  const long c,
+                  const Variable& result);
+    virtual void init();
+
+  public:
+    void generateConstraints();
+    size_t numConstraints() const;
+    void generateWitness();
+    bool tapeOp(TapeOp& op) const;
+    static GadgetPtr create(ProtoboardPtr pb,
+                            const Variable& A,
+                            const long c,
+                            const Variable& result);
+
+  private:
+    const Variable A_;
+    const long c_;
+    const Variable result_;
+
+    DISALLOW_COPY_AND_ASSIGN(MULConst_Gadget);
+};
+
+/*********************************/
+/***   END OF MULConst_Gadget  ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************             UDivisionConst_Gadget classes                  ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// Unsigned A = c * Q + R, 0 <= R < c, for a non-zero constant divisor c.
+/// c == 2^k   : A is decomposed once, Q and R are slices of its bits.
+/// otherwise  : R and c-1-R are range checked on bitlen(c) bits and Q on
+///              64 - floor(log2 c) bits, so c * Q + R cannot wrap the field.
+class UDivisionConst_Gadget: public DenseGadget
+{
+  private:
+    UDivisionConst_Gadget(ProtoboardPtr pb,
+                            const Variable& A,
+                            const unsigned long c,
+                            const Variable& Q,
+                            const Variable& R);
+    virtual void init();
+
+  public:
+    void generateConstraints();
+    size_t numConstraints() const;
+    void generateWitness();
+    static GadgetPtr create(ProtoboardPtr pb,
+                            const Variable& A,
+                            const unsigned long c,
+                            const Variable& Q,
+                            const Variable& R);
+
+    static bool isPowerOfTwo(unsigned long c) { return c != 0 && (c & (c - 1)) == 0; }
+    static size_t bitLength(unsigned long c) { size_t n = 0; while (c) { c >>= 1; ++n; } return n; }
+
+  private:
+    static const int BIT_SIZE = WORD_BIT_SIZE;
+
+    const Variable A_;
+    const unsigned long c_;
+    const Variable Q_;
+    const Variable R_;
+    const Variable S_;      // c - 1 - R
+
+    const size_t bitlenc_;  // number of significant bits of c
+    const size_t log2c_;    // floor(log2 c)
+
+    UnpackedWord A_alpha_u_;
+    UnpackedWord Q_alpha_u_;
+    UnpackedWord R_alpha_u_;
+    UnpackedWord S_alpha_u_;
+
+    GadgetPtr alphaDualVariablePacker1_;
+    GadgetPtr alphaDualVariablePacker2_;
+    GadgetPtr alphaDualVariablePacker3_;
+    GadgetPtr alphaDualVariablePacker4_;
+
+    DISALLOW_COPY_AND_ASSIGN(UDivisionConst_Gadget);
+};
+
+/*********************************/
+/*** END OF UDivisionConst_Gadget ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                  CMPConst_Gadget classes                   ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// Ordered comparison of A with a constant c known when the circuit is built.
+///   constIsLhs == false : result = A > c   (A >= c if orEqual)
+///   constIsLhs == true  : result = c > A   (c >= A if orEqual)
+/// A is decomposed once; bits of A above bitlen(c) are folded into a single
+/// non-zero test and only the significant bits of c are walked, one
+/// constraint per bit. For a signed comparison the sign bit of A joins that
+/// test and a negative c walks bitlen(~c) bits, so the count follows |c|.
+class CMPConst_Gadget : public DenseGadget
+{
+  private:
+    CMPConst_Gadget(ProtoboardPtr pb,
+                  const Variable& A,
+                  const unsigned long c,
+                  const bool isSigned,
+                  const bool orEqual,
+                  const bool constIsLhs,
+                  const Variable& result);
+    virtual void init();
+
+  public:
+    void generateConstraints();
+    size_t numConstraints() const;
+    void generateWitness();
+    static GadgetPtr create(ProtoboardPtr pb,
+                            const Variable& A,
+                            const unsigned long c,
+                            const bool isSigned,
+                            const bool orEqual,
+                            const bool constIsLhs,
+                            const Variable& result);
+
+  private:
+    static const int BIT_SIZE = WORD_BIT_SIZE;
+
+    const Variable A_;
+    const unsigned long c_;
+    const bool isSigned_;
+    const bool isNegative_;     // signed and c < 0
+    const bool orEqual_;
+    const bool constIsLhs_;
+    const Variable result_;
+    const size_t bitlenc_;
+
+    UnpackedWord A_alpha_u_;
+    const Variable high_;       // 1 iff A differs from c's fill above bitlen(c)
+    const Variable highInv_;
+    VariableArray prod_;        // eq_i * A[i] for each walked bit
+
+    GadgetPtr alphaDualVariablePacker1_;
+
+    DISALLOW_COPY_AND_ASSIGN(CMPConst_Gadget);
+};
+
+/*********************************/
+/***  END OF CMPConst_Gadget    ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                   EQConst_Gadget classes                   ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// result = (A == c), or (A != c) if isNeq, for a constant c.
+/// The constant is folded into the linear combinations; one inverse witness.
+class EQConst_Gadget : public DenseGadget
+{
+  private:
+    EQConst_Gadget(ProtoboardPtr pb,
+                  const Variable& A,
+                  const long c,
+                  const bool isNeq,
+                  const Variable& result);
+    virtual void init();
+
+  public:
+    void generateConstraints();
+    size_t numConstraints() const;
+    void generateWitness();
+    static GadgetPtr create(ProtoboardPtr pb,
+                            const Variable& A,
+                            const long c,
+                            const bool isNeq,
+                            const Variable& result);
+
+  private:
+    const Variable A_;
+    const long c_;
+    const bool isNeq_;
+    const Variable result_;
+    const Variable aux_;
+
+    DISALLOW_COPY_AND_ASSIGN(EQConst_Gadget);
+};
+
+/*********************************/
+/***   END OF EQConst_Gadget   ***/
+/*********************************/
+
+
+/*************************************************************************************************/
+/*************************************************************************************************/
+/*******************                                                            ******************/
+/*******************                   POWMOD_Gadget classes                    ******************/
+/*******************                                                            ******************/
+/*************************************************************************************************/
+/*************************************************************************************************/
+
+/// result = base ^ exp mod m on unsigned words. A modulus of 0, constant or
+/// variable, stands for 2^64 and gives the wrapping power of G_POW. Square-and-multiply over the exponent bits:
+/// each step computes u = r * r * f, f = base or 1, and does a single
+/// reduction u = q * m + r' with r' < m. The base is reduced first so every
+/// r, f < m and q fits on 2 * bitlen(m) bits.
+/// A constant exponent takes bitlen(exp) - 1 steps with f fixed by its bits;
+/// a variable exponent is decomposed on 64 bits and takes 64 steps.
+/// base, exp and mod may take any value below 2^64 but must hold it as that
+/// non-negative field element (an unsigned word, not a negative signed one);
+/// generateWitness asserts it.
+class POWMOD_Gadget : public DenseGadget
+{
+  private:
+    POWMOD_Gadget(ProtoboardPtr pb,
+                  const Variable& base,
+                  const Variable& exp,
+                  const Variable& mod,
+                  const Variable& result,
+                  const bool isExpConst,
+                  const unsigned long expConst,
+                  const bool isModConst,
+                  const unsigned long modConst);
+    virtual void init();
+
+  public:
+    void generateConstraints();
+    size_t numConstraints() const;
+    void generateWitness();
+    static GadgetPtr create(ProtoboardPtr pb,
+                            const Variable& base,
+                            const Variable& exp,
+                            const Variable& mod,
+                            const Variable& result,
+                            const bool isExpConst,
+                            const unsigned long expConst,
+                            const bool isModConst,
+                            const unsigned long modConst);
+
+  private:
+    static const int BIT_SIZE = WORD_BIT_SIZE;
+
+    static size_t numSteps(const bool isExpConst, const unsigned long expConst);
+    bool multiplies(size_t step) const;
+    LinearCombination modulus() const;
+    unsigned long word(const Variable& var);
+    LinearCombination accumulator(size_t step) const;
+    void addReductionVariables(size_t qBits);
+    void addReduction(size_t k, const LinearCombination& u);
+    void setReduction(size_t k, unsigned __int128 q, unsigned __int128 r, unsigned __int128 m);
+
+    const Variable base_;
+    const Variable exp_;            // unused if isExpConst_
+    const Variable mod_;            // unused if isModConst_
+    const Variable modIsZero_;      // 1 iff a variable mod_ is 0, i.e. 2^64
+    const Variable modInv_;
+    const Variable result_;
+    const bool isExpConst_;
+    const unsigned long expConst_;
+    const bool isModConst_;
+    const unsigned long modConst_;  // 0 stands for 2^64
+    const size_t modBits_;
+    const size_t numSteps_;
+
+    UnpackedWord expBits_;          // variable exponent only
+    VariableArray sq_;              // r * r of each step
+    VariableArray f_;               // base or 1 of each step, variable exponent only
+    VariableArray u_;               // r * r * f of each multiplying step
+    // reduction k: u = q * m + r and s = m - 1 - r, k = 0 reduces the base
+    ::std::vector<VariableArray> qBits_;
+    ::std::vector<VariableArray> rBits_;
+    ::std::vector<VariableArray> sBits_;
+
+    DISALLOW_COPY_AND_ASSIGN(POWMOD_Gadget);
+};
+
+/*********************************/
+/***   END OF POWMOD_Gadget    ***/
+/*********************************/
+
+
 
 /*********************************/
 /***       END OF VCGadget      ***/
@@ -1,10 +1,15 @@
 // system header
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <fstream>
 #include <string>
 #include <cstdlib>
+#include <climits>
 #include <iostream>
 #include <sstream>
+#include <set>
+#include <unordered_map>
 
 // libsnark header
 #include <libff/common/profiling.hpp>
@@ -17,9 +22,23 @@
 #include <libsnark/gadgetlib2/integration.hpp>
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
+#include <libsnark/common/default_types/r1cs_gg_ppzksnark_pp.hpp>
+#include <libsnark/zk_proof_systems/ppzksnark/r1cs_gg_ppzksnark/r1cs_gg_ppzksnark.hpp>
 #include <libsnark/gadgetlib2/adapters.hpp>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef MULTICORE
+#include <omp.h>
+#endif
 #include "goLayer.h"
 #include "gadget2.hpp"
+#include "optimizer.hpp"
+#include "keygen.hpp"
+#include "checkpoint.hpp"
+#include "keystore.hpp"
 
 using namespace libsnark;
 using namespace gadgetlib2;
@@ -44,13 +63,49 @@ extern "C"
 	/// golbal var define
 	ProtoboardPtr g_pbp;	
 	map<void*, Variable*> g_mapVar;
+	map<Variable*, uint64> g_mapConst;
 	vector<GadgetPtr> g_vectGadgets;
 	int64_t g_RetIndex;
+	vector<size_t> g_vectRemovedVars;
+	bool g_bLinearElim = true;
+	vector<SSA_Node*> g_vectNodes;
+	vector<uint64> g_vectOutputs;
+	vector<bool> g_vectLive;
+	size_t g_PrimaryInputs = 0;		// public inputs of the exported or proven r1cs, liveness roots
+	vector<bool> g_vectConstrained;	// live gadgets whose constraints were generated
+	vector<bool> g_vectWitnessed;	// live gadgets of the last witness generation
+	Gadget_Stats g_Stats;
+	map<vector<uint64>, Variable*> g_mapCSE;
+	bool g_bCSE = false;
+	set<Variable*> g_setDirty;		// variables set since the last witness generation
+	set<int64_t> g_setWritten;		// results of the gadgets created so far
+	bool g_bWitnessDone = false;
+	WitnessTape g_tape;				// witness op of each gadget of g_vectGadgets
+	void *g_hWitnessLib = nullptr;	// shared object loaded by gadget_loadWitnessCode
+	Witness_Func g_pfnWitness = nullptr;
+	uint64_t g_WitnessHash = 0;		// WitnessTape::hash g_pfnWitness was generated for
+	vector<Circuit_Var> g_vectCircuitVars;		// api calls of the session, see gadget_saveCircuit
+	vector<Circuit_Const> g_vectCircuitConsts;
+	vector<Circuit_Node> g_vectCircuitNodes;
+	vector<int64> g_vectCircuitOutputs;
+	int g_nThreads = 0;				// csnark_set_threads budget, 0 keeps the OpenMP default
 	
 	/// forward declaration
 	uint64 AssignVar2SSANode(void* ptr);
 
 	void Serial_pkey(const r1cs_ppzksnark_proving_key<default_r1cs_ppzksnark_pp> &pk, std::string &pkey);
+	void Serial_removedVars(std::ostream &ostr);
+	void Deserial_removedVars(std::istream &istr);
+	const char* ProofSystemTag(int32 ProofSystem);
+	int32 ReadProofSystemTag(std::istream &istr);
+	void Serial_gg_pkey(const r1cs_gg_ppzksnark_proving_key<default_r1cs_gg_ppzksnark_pp> &pk, std::string &pkey);
+	void Deserial_gg_pkey(r1cs_gg_ppzksnark_proving_key<default_r1cs_gg_ppzksnark_pp> &pk, const std::string &pkey);
+	void Serial_gg_vkey(const r1cs_gg_ppzksnark_verification_key<default_r1cs_gg_ppzksnark_pp> &vk, std::string &vkey);
+	void Deserial_gg_vkey(r1cs_gg_ppzksnark_verification_key<default_r1cs_gg_ppzksnark_pp> &vk, const std::string &vkey);
+	void Serial_gg_proof(const r1cs_gg_ppzksnark_proof<default_r1cs_gg_ppzksnark_pp> &r1cs_proof, std::string &proof);
+	void Deserial_gg_proof(r1cs_gg_ppzksnark_proof<default_r1cs_gg_ppzksnark_pp> &r1cs_proof, const std::string &proof);
+	void GetProverInput(size_t NumInputs, r1cs_primary_input<FieldT> &Primary, r1cs_auxiliary_input<FieldT> &Auxiliary);
+	void ApplyThreadBudget();
 	void Deserial_pkey(r1cs_ppzksnark_proving_key<default_r1cs_ppzksnark_pp> &pk, const std::string &pkey);
 	void Serial_vkey(const r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> &vk, std::string &vkey);
 	void Deserial_vkey(r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> &vk, const std::string &vkey);
@@ -60,6 +115,17 @@ extern "C"
 	void Serial_output(const FieldT output, std::string &strOutput);
 
 	SSA_Node* CreateSSANode(int64_t input0, int64_t input1, int64_t input2, int64_t result, int32 Type);
+	bool GetConstVal(uint64 pVar, uint64 &Val);
+	GadgetPtr CreateCmpConstGadget(SSA_Node* pNode, bool isSigned, bool orEqual);
+	void MarkLiveGadgets();
+	void ReviveInputGadgets(size_t NumInputs, vector<bool> &vectDone, bool bWitness);
+	void GetWitnessLevels(vector<vector<size_t> > &vectLevels);
+	void GenerateGadgetConstraints();
+	DenseProtoboard* BuildWitnessTape();
+	bool FindCommonGadget(int64_t input0, int64_t input1, int64_t input2, int64_t result, int32 Type, vector<uint64> &Key);
+	int32 GetInputCount(int32 Type);
+	FlatRef PBVal(const Variable &var);
+	r1cs_variable_assignment<FieldT> GetVariableAssignment();
 	ProtoboardPtr getPBP() { return g_pbp; };
 
 	/// create gadget declaration
@@ -86,12 +152,15 @@ extern "C"
 	void CreateSgeGadget(SSA_Node* pNode);
 	void CreateUgtGadget(SSA_Node* pNode);
 	void CreateUgeGadget(SSA_Node* pNode);
+	void CreatePowGadget(SSA_Node* pNode);
+	void CreatePowModGadget(SSA_Node* pNode);
 
 	/// init gadget env
 	void gadget_initEnv() {
 		initPublicParamsFromDefaultPp();
 		GadgetLibAdapter::resetVariableIndex();
-		g_pbp = Protoboard::create(R1P);
+		g_pbp = DenseProtoboard::create(R1P);
+		DenseProtoboard::find(g_pbp)->setDirect(true);
 		cout << "call gadget_initEnv success ..." << endl;
 
     libff::inhibit_profiling_info = true;
@@ -100,13 +169,44 @@ extern "C"
 
 	/// uninit gadget env
 	void gadget_uninitEnv() {
-		//delete pb variable
+		//delete pb variable(cse results are shared by several ssa values)
+		set<Variable*> setVar;
 		for (auto ItemV : g_mapVar)
-			delete ItemV.second;
+			setVar.insert(ItemV.second);
+		for (auto pVar : setVar)
+			delete pVar;
 		g_mapVar.clear();
+		g_mapCSE.clear();
+		g_mapConst.clear();
+		g_vectRemovedVars.clear();
 
 		//delete gadget(auto release)
 		g_vectGadgets.clear();
+
+		//delete ssa node
+		for (auto pNode : g_vectNodes)
+			delete pNode;
+		g_vectNodes.clear();
+		g_vectOutputs.clear();
+		g_vectLive.clear();
+		g_PrimaryInputs = 0;
+		g_vectConstrained.clear();
+		g_vectWitnessed.clear();
+		g_setDirty.clear();
+		g_setWritten.clear();
+		g_bWitnessDone = false;
+		g_tape.clear();
+		g_pfnWitness = nullptr;
+		g_WitnessHash = 0;
+		if (g_hWitnessLib)
+			dlclose(g_hWitnessLib);
+		g_hWitnessLib = nullptr;
+		g_vectCircuitVars.clear();
+		g_vectCircuitConsts.clear();
+		g_vectCircuitNodes.clear();
+		g_vectCircuitOutputs.clear();
+		g_RetIndex = 0;
+		g_Stats = Gadget_Stats();
 		cout << "call gadget_uninitEnv success ..." << endl;
 	}
 	
@@ -120,6 +220,7 @@ extern "C"
     if (it == g_mapVar.end()) {
     	pbvar = new Variable;
     	g_mapVar[(void *)ptr] = pbvar;
+    	g_vectCircuitVars.push_back({ptr, 0});
     	cout << "create variable  " << ptr  << " success." << endl;
     } else {
       pbvar = it->second;
@@ -132,6 +233,17 @@ extern "C"
 	unsigned char gadget_createGadget(int64_t input0, int64_t input1, int64_t input2, int64_t result, int32 Type) {		
 		assert(input0);
 		assert(result);
+		// ssa: a second gadget would constrain the variable twice, unsatisfiably
+		if (!g_setWritten.insert(result).second) {
+			cout << "variable " << result << " already has a gadget" << endl;
+			return 0;
+		}
+		g_vectCircuitNodes.push_back({Type, 0, {input0, input1, input2}, result});
+
+		// reuse the result of an identical gadget
+		vector<uint64> Key;
+		if (FindCommonGadget(input0, input1, input2, result, Type, Key))
+			return 1;
 
 		// create ssa node
     	SSA_Node* pNode = CreateSSANode(input0, input1, input2, result, Type);
@@ -234,11 +346,25 @@ extern "C"
 			case G_UGE:
 			CreateUgeGadget(pNode);
 			break;		
+
+			case G_POW:
+			CreatePowGadget(pNode);
+			break;
+
+			case G_POWMOD:
+			CreatePowModGadget(pNode);
+			break;
 			default:
 			cout << "unkown ssa type " << Type << endl;
 			return 0;
 			break;
 		}
+
+		// keep the ssa node of each gadget for the liveness analysis
+		assert(g_vectGadgets.size() == g_vectNodes.size() + 1);
+		g_vectNodes.emplace_back(pNode);
+		if (!Key.empty())
+			g_mapCSE[Key] = (Variable*)pNode->Result;
 		
 		return 1;
 	}
@@ -248,19 +374,31 @@ extern "C"
 		assert(ptr);
 		cout << "set var " << ptr << " value " << Val << endl;
 		map<void*, Variable*>::iterator it = g_mapVar.find((void *)ptr);
-		if (it != g_mapVar.end()) 
-			g_pbp->val(*(it->second)) = Val;
+		if (it != g_mapVar.end()) {
+			PBVal(*(it->second)) = (long)Val;
+			g_setDirty.insert(it->second);
+		}
 		else
 			cout << "PB Variable " << ptr << " not exist." << endl;
 	}
 	
+	/// declare a compile-time constant; must be called before the gadgets using it are created
+	void gadget_setConstVar(int64_t ptr, int64 Val) {
+		assert(ptr);
+		Variable *pVar = (Variable*)gadget_createPBVar(ptr);
+		g_mapConst[pVar] = (uint64)Val;
+		g_vectCircuitConsts.push_back({ptr, Val});
+		PBVal(*pVar) = (long)Val;
+		DBG_MSG("set const var %ld value %lld\n", ptr, Val);
+	}
+
 	/// get variable value
 	long gadget_getVar(int64_t ptr){
 		assert(ptr);
 		long destVal = 0;
 		map<void*, Variable*>::iterator it = g_mapVar.find((void *)ptr);
 		if (it != g_mapVar.end()) 
-		destVal = g_pbp->val(*(it->second)).asLong();
+		destVal = PBVal(*(it->second)).asLong();
 		else
 		cout << "PB Variable " << ptr << " not exist." << endl;
 
@@ -273,17 +411,310 @@ extern "C"
 		g_RetIndex = ptr;
 	}
 
+	/// declare a public output or assertion besides the return value
+	void gadget_addOutput(int64_t ptr) {
+		assert(ptr);
+		g_vectOutputs.emplace_back(gadget_createPBVar(ptr));
+		g_vectCircuitOutputs.emplace_back(ptr);
+	}
+
+	/// mark a variable as public input of the circuit (recorded in the circuit file)
+	void gadget_setPublicVar(int64_t ptr) {
+		assert(ptr);
+		gadget_createPBVar(ptr);
+		for (auto &Var : g_vectCircuitVars)
+			if (Var.Id == ptr)
+				Var.Flags |= CIRCUIT_VAR_PUBLIC;
+	}
+
+	/// number of variables marked by gadget_setPublicVar
+	unsigned gadget_getPublicVarCount() {
+		unsigned Count = 0;
+		for (auto &Var : g_vectCircuitVars)
+			Count += (Var.Flags & CIRCUIT_VAR_PUBLIC) ? 1 : 0;
+		return Count;
+	}
+
+	/// the variables marked by gadget_setPublicVar have the indexes 0..N-1 (N their
+	/// count), i.e. they are the primary input of the exported constraint system
+	unsigned char gadget_checkPublicVars() {
+		const unsigned Count = gadget_getPublicVarCount();
+		vector<bool> vectSeen(Count, false);
+		for (auto &Var : g_vectCircuitVars) {
+			if (!(Var.Flags & CIRCUIT_VAR_PUBLIC))
+				continue;
+			const size_t Index = GadgetLibAdapter::getVariableIndex(*g_mapVar[(void*)Var.Id]);
+			if (Index >= Count || vectSeen[Index])
+				return false;
+			vectSeen[Index] = true;
+		}
+		return true;
+	}
+
+	/// write the circuit built by the api calls of this session (see Circuit_Header)
+	unsigned char gadget_saveCircuit(const char *pPath) {
+		assert(pPath);
+		Circuit_Header Header = {CIRCUIT_MAGIC, CIRCUIT_VERSION, g_vectCircuitVars.size(), g_vectCircuitConsts.size(),
+								 g_vectCircuitNodes.size(), g_vectCircuitOutputs.size(), g_RetIndex};
+		ofstream out(pPath, ios::binary);
+		if (!out) {
+			cout << "cannot write " << pPath << endl;
+			return false;
+		}
+		out.write((const char*)&Header, sizeof(Header));
+		out.write((const char*)g_vectCircuitVars.data(), g_vectCircuitVars.size() * sizeof(Circuit_Var));
+		out.write((const char*)g_vectCircuitConsts.data(), g_vectCircuitConsts.size() * sizeof(Circuit_Const));
+		out.write((const char*)g_vectCircuitNodes.data(), g_vectCircuitNodes.size() * sizeof(Circuit_Node));
+		out.write((const char*)g_vectCircuitOutputs.data(), g_vectCircuitOutputs.size() * sizeof(int64));
+		return out.good();
+	}
+
+	/// build the circuit of a gadget_saveCircuit file in one pass over the mapped file.
+	/// Must follow gadget_initEnv before any other call; inputs are then set with gadget_setVar.
+	/// The public variables are declared first so that they take the first indexes,
+	/// the primary input of the exported constraint system
+	unsigned char gadget_loadCircuit(const char *pPath) {
+		assert(pPath);
+		if (!g_mapVar.empty() || !g_vectCircuitNodes.empty()) {
+			cout << "gadget_loadCircuit needs an empty environment" << endl;
+			return false;
+		}
+		int fd = open(pPath, O_RDONLY);
+		if (fd < 0) {
+			cout << "cannot open " << pPath << endl;
+			return false;
+		}
+		struct stat st;
+		void *pMap = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Circuit_Header))
+			pMap = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (pMap == MAP_FAILED) {
+			cout << "cannot map " << pPath << endl;
+			return false;
+		}
+
+		// counts are checked one by one against the file size so they cannot overflow
+		const Circuit_Header *pHeader = (const Circuit_Header*)pMap;
+		const size_t Size = st.st_size;
+		size_t Need = sizeof(Circuit_Header);
+		bool bValid = pHeader->Magic == CIRCUIT_MAGIC && pHeader->Version == CIRCUIT_VERSION;
+		const uint64 Counts[] = {pHeader->VarCount, pHeader->ConstCount, pHeader->NodeCount, pHeader->OutputCount};
+		const size_t RecSize[] = {sizeof(Circuit_Var), sizeof(Circuit_Const), sizeof(Circuit_Node), sizeof(int64)};
+		for (int i = 0; i < 4 && bValid; i++) {
+			bValid = Counts[i] <= (Size - Need) / RecSize[i];
+			Need += bValid ? Counts[i] * RecSize[i] : 0;
+		}
+		if (!bValid || Need != Size) {
+			cout << pPath << " is not a version " << CIRCUIT_VERSION << " circuit file" << endl;
+			munmap(pMap, Size);
+			return false;
+		}
+
+		const Circuit_Var *pVars = (const Circuit_Var*)(pHeader + 1);
+		const Circuit_Const *pConsts = (const Circuit_Const*)(pVars + pHeader->VarCount);
+		const Circuit_Node *pNodes = (const Circuit_Node*)(pConsts + pHeader->ConstCount);
+		const int64 *pOutputs = (const int64*)(pNodes + pHeader->NodeCount);
+
+		// every record is checked before anything is built
+		for (uint64 i = 0; i < pHeader->VarCount && bValid; i++)
+			bValid = pVars[i].Id != 0;
+		for (uint64 i = 0; i < pHeader->ConstCount && bValid; i++)
+			bValid = pConsts[i].Id != 0;
+		for (uint64 i = 0; i < pHeader->NodeCount && bValid; i++) {
+			const Circuit_Node &Node = pNodes[i];
+			bValid = Node.type >= G_ADD && Node.type <= G_POWMOD && Node.Result != 0;
+			for (int32 k = 0; k < GetInputCount(Node.type) && bValid; k++)
+				bValid = Node.Input[k] != 0;
+		}
+		for (uint64 i = 0; i < pHeader->OutputCount && bValid; i++)
+			bValid = pOutputs[i] != 0;
+		if (!bValid) {
+			cout << pPath << " has an invalid variable, constant, node or output record" << endl;
+			munmap(pMap, Size);
+			return false;
+		}
+
+		unsigned char Res = true;
+		for (uint64 i = 0; i < pHeader->VarCount; i++)
+			if (pVars[i].Flags & CIRCUIT_VAR_PUBLIC)
+				gadget_setPublicVar(pVars[i].Id);
+		for (uint64 i = 0; i < pHeader->VarCount; i++)
+			gadget_createPBVar(pVars[i].Id);
+		for (uint64 i = 0; i < pHeader->ConstCount; i++)
+			gadget_setConstVar(pConsts[i].Id, pConsts[i].Val);
+		for (uint64 i = 0; i < pHeader->NodeCount && Res; i++) {
+			const Circuit_Node &Node = pNodes[i];
+			Res = gadget_createGadget(Node.Input[0], Node.Input[1], Node.Input[2], Node.Result, Node.type);
+		}
+		for (uint64 i = 0; i < pHeader->OutputCount; i++)
+			gadget_addOutput(pOutputs[i]);
+		if (pHeader->RetIndex)
+			gadget_setRetIndex(pHeader->RetIndex);
+		munmap(pMap, Size);
+		return Res;
+	}
+
+	/// get gadget statistics
+	void gadget_getStats(Gadget_Stats *pStats) {
+		assert(pStats);
+		*pStats = g_Stats;
+	}
+
+	/// limit the parallel work of the session (constraints, witness and its conversion,
+	/// key generation, prover multi-exponentiations and FFTs) to n threads, n <= 0 for
+	/// the OpenMP default. Returns the thread count used, 1 without MULTICORE
+	int csnark_set_threads(int n) {
+		g_nThreads = n > 0 ? n : 0;
+		ApplyThreadBudget();
+#ifdef MULTICORE
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+
+	/// the OpenMP thread count belongs to the calling thread and cgo calls may come
+	/// from any thread, so each parallel entry point sets it again
+	void ApplyThreadBudget() {
+#ifdef MULTICORE
+		static const int DefaultThreads = omp_get_max_threads();
+		omp_set_num_threads(g_nThreads > 0 ? g_nThreads : DefaultThreads);
+#endif
+	}
+
 	/// generate R1cs
 	void gadget_generateConstraints() {	
-		for (auto Item : g_vectGadgets)
-			Item->generateConstraints();
+		ApplyThreadBudget();
+		MarkLiveGadgets();
+		GenerateGadgetConstraints();
+		g_vectConstrained = g_vectLive;
+
+		// dead gadgets are counted, never generated: their rows would have no witness
+		g_Stats.DroppedConstraints = 0;
+		for (size_t i = 0; i < g_vectGadgets.size(); i++)
+			if (!g_vectLive[i])
+				g_Stats.DroppedConstraints += dynamic_cast<const DenseGadget&>(*g_vectGadgets[i]).numConstraints();
+		g_Stats.DroppedVars = 0;
+		if (g_Stats.DroppedGadgets) {
+			const SparseR1CS &R1CS = DenseProtoboard::find(g_pbp)->sparseR1CS();
+			g_Stats.DroppedVars = GadgetLibAdapter::getNextFreeIndex() - R1CS.countUsedVariables(R1CS.numConstraints());
+		}
 	}
 
 	/// generate witness
 	void gadget_generateWitness() {	
 		// generate witness
-		for (auto Item : g_vectGadgets)
-			Item->generateWitness();
+		ApplyThreadBudget();
+		MarkLiveGadgets();
+		DenseProtoboard *pDense = BuildWitnessTape();
+		if (g_pfnWitness && g_tape.hash(g_vectLive) != g_WitnessHash) {
+			cout << "loaded witness code does not match the live gadgets, running the tape" << endl;
+			g_pfnWitness = nullptr;
+		}
+		if (g_pfnWitness) {
+			pDense->reserve();
+			g_tape.runCompiled(*pDense, g_pfnWitness);
+			g_vectWitnessed = g_vectLive;
+			g_setDirty.clear();
+			g_bWitnessDone = true;
+			return;
+		}
+#ifdef MULTICORE
+		// gadgets of one level only read results of earlier levels
+		vector<vector<size_t> > vectLevels;
+		GetWitnessLevels(vectLevels);
+		for (auto &Level : vectLevels) {
+			#pragma omp parallel for schedule(dynamic) if (Level.size() > 1)
+			for (long i = 0; i < (long)Level.size(); i++)
+				g_tape.run(*pDense, Level[i]);
+		}
+#else
+		for (size_t i = 0; i < g_vectGadgets.size(); i++)
+			if (g_vectLive[i])
+				g_tape.run(*pDense, i);
+#endif
+		g_vectWitnessed = g_vectLive;
+		g_setDirty.clear();
+		g_bWitnessDone = true;
+	}
+
+	/// write the witness of the live gadgets as a C++ function named pSymbol (see
+	/// WitnessTape::emitCode); build it with -shared -fPIC and src/ on the include path
+	unsigned char gadget_emitWitnessCode(const char *pPath, const char *pSymbol) {
+		assert(pPath && pSymbol);
+		MarkLiveGadgets();
+		BuildWitnessTape();
+		ofstream out(pPath);
+		if (!out) {
+			cout << "cannot write " << pPath << endl;
+			return false;
+		}
+		g_tape.emitCode(out, pSymbol, g_vectLive);
+		return out.good();
+	}
+
+	/// load a witness function built from gadget_emitWitnessCode; gadget_generateWitness
+	/// then runs it instead of the tape. Fails (0) if it was generated for other gadgets
+	unsigned char gadget_loadWitnessCode(const char *pPath, const char *pSymbol) {
+		assert(pPath && pSymbol);
+		void *hLib = dlopen(pPath, RTLD_NOW | RTLD_LOCAL);
+		if (!hLib) {
+			cout << "dlopen " << pPath << " fail: " << dlerror() << endl;
+			return false;
+		}
+		const string strSymbol = pSymbol;
+		Witness_Func pfnWitness = (Witness_Func)dlsym(hLib, pSymbol);
+		const size_t *pOps = (const size_t*)dlsym(hLib, (strSymbol + "_ops").c_str());
+		const size_t *pLive = (const size_t*)dlsym(hLib, (strSymbol + "_live").c_str());
+		const uint64_t *pHash = (const uint64_t*)dlsym(hLib, (strSymbol + "_hash").c_str());
+
+		MarkLiveGadgets();
+		BuildWitnessTape();
+		const size_t Live = count(g_vectLive.begin(), g_vectLive.end(), true);
+		if (!pfnWitness || !pOps || !pLive || !pHash || *pOps != g_tape.size() || *pLive != Live
+			|| *pHash != g_tape.hash(g_vectLive)) {
+			cout << pSymbol << " in " << pPath << " does not match the gadgets" << endl;
+			dlclose(hLib);
+			return false;
+		}
+		if (g_hWitnessLib)
+			dlclose(g_hWitnessLib);
+		g_hWitnessLib = hLib;
+		g_pfnWitness = pfnWitness;
+		g_WitnessHash = *pHash;
+		return true;
+	}
+
+	/// recompute only the gadgets downstream of the variables set since the last
+	/// witness generation; falls back to gadget_generateWitness the first time
+	void gadget_regenerateWitness() {
+		if (!g_bWitnessDone || g_vectLive.size() != g_vectGadgets.size()) {
+			gadget_generateWitness();
+			return;
+		}
+
+		DenseProtoboard *pDense = BuildWitnessTape();
+		// gadgets are in ssa order, a rerun gadget dirties its result. Every variable
+		// has a single writer (see gadget_createGadget), so a rerun reader sees the
+		// value its writer left.
+		size_t Rerun = 0;
+		for (size_t i = 0; i < g_vectGadgets.size() && !g_setDirty.empty(); i++) {
+			if (!g_vectLive[i])
+				continue;
+			SSA_Node *pNode = g_vectNodes[i];
+			Variable *pResult = (Variable*)pNode->Result;
+			bool bDirty = g_setDirty.count(pResult) > 0;
+			for (int32 k = 0; k < GetInputCount(pNode->type) && !bDirty; k++)
+				bDirty = g_setDirty.count((Variable*)pNode->Input[k]) > 0;
+			if (!bDirty)
+				continue;
+			g_tape.run(*pDense, i);
+			g_setDirty.insert(pResult);
+			++Rerun;
+		}
+		DBG_MSG("regenerate witness: %lu of %lu gadgets\n", Rerun, g_vectGadgets.size());
+		g_setDirty.clear();
 	}
 	
 	///	generate proof and result(1=OK, 0=Fail)
@@ -291,31 +722,39 @@ extern "C"
 		assert(pPKEY);
 		assert(pProof);
 		
-		// deserialization pk
+		// the key's tag selects the proof system
 		cout << "entry GenerateProof func" << endl;
-		r1cs_ppzksnark_proving_key<libff::default_ec_pp> pk;
+		ApplyThreadBudget();
 		const string strpk = pPKEY;
-		Deserial_pkey(pk, strpk);
-		cout << "call Deserial_pkey success..." << endl;
-		cout << "Number of R1CS constraints: " << pk.constraint_system.num_constraints() << endl;
-		
-		// get var assignment
-		const r1cs_variable_assignment<FieldT> full_assignment = get_variable_assignment_from_gadgetlib2(*g_pbp);
-        
-    cout << "call get_variable_assignment_from_gadgetlib2 success..." << endl;
-
-		// get primary and auxiliary input
-		r1cs_primary_input<FieldT> primary_input(full_assignment.begin(), full_assignment.begin() + pk.constraint_system.num_inputs());
-		r1cs_auxiliary_input<FieldT> auxiliary_input(full_assignment.begin() + pk.constraint_system.num_inputs(), full_assignment.end());
-		
-		
-		// call libsnark prover to generate proof
-		r1cs_ppzksnark_proof<default_r1cs_ppzksnark_pp> proof = r1cs_ppzksnark_prover<default_r1cs_ppzksnark_pp>(pk, primary_input, auxiliary_input);
-		cout << "call r1cs_ppzksnark_prover success..." << endl;
-
-		// serialization proof and result
+		std::istringstream istrTag(strpk);
+		r1cs_primary_input<FieldT> primary_input;
+		r1cs_auxiliary_input<FieldT> auxiliary_input;
 		string strProof;
-		Serial_proof(proof, strProof);
+		if (ReadProofSystemTag(istrTag) == PS_GROTH16) {
+			// deserialization pk
+			r1cs_gg_ppzksnark_proving_key<default_r1cs_gg_ppzksnark_pp> pk;
+			Deserial_gg_pkey(pk, strpk);
+			cout << "call Deserial_gg_pkey success..." << endl;
+			cout << "Number of R1CS constraints: " << pk.constraint_system.num_constraints() << endl;
+			GetProverInput(pk.constraint_system.num_inputs(), primary_input, auxiliary_input);
+
+			// call libsnark prover to generate proof
+			r1cs_gg_ppzksnark_proof<default_r1cs_gg_ppzksnark_pp> proof = r1cs_gg_ppzksnark_prover<default_r1cs_gg_ppzksnark_pp>(pk, primary_input, auxiliary_input);
+			cout << "call r1cs_gg_ppzksnark_prover success..." << endl;
+			Serial_gg_proof(proof, strProof);
+		} else {
+			// deserialization pk
+			r1cs_ppzksnark_proving_key<libff::default_ec_pp> pk;
+			Deserial_pkey(pk, strpk);
+			cout << "call Deserial_pkey success..." << endl;
+			cout << "Number of R1CS constraints: " << pk.constraint_system.num_constraints() << endl;
+			GetProverInput(pk.constraint_system.num_inputs(), primary_input, auxiliary_input);
+
+			// call libsnark prover to generate proof
+			r1cs_ppzksnark_proof<default_r1cs_ppzksnark_pp> proof = r1cs_ppzksnark_prover<default_r1cs_ppzksnark_pp>(pk, primary_input, auxiliary_input);
+			cout << "call r1cs_ppzksnark_prover success..." << endl;
+			Serial_proof(proof, strProof);
+		}
 		cout << "call Serial_proof success..." << endl;
 		cout << "proof buffer size=" << strProof.size() << endl;
 		if (strProof.size() > prSize) {
@@ -326,6 +765,22 @@ extern "C"
 		return 1;
 	}
 
+	/// primary and auxiliary input of the witness for a key with NumInputs public inputs
+	void GetProverInput(size_t NumInputs, r1cs_primary_input<FieldT> &Primary, r1cs_auxiliary_input<FieldT> &Auxiliary) {
+		// get var assignment, with the public inputs the key expects
+		ReviveInputGadgets(NumInputs, g_vectWitnessed, true);
+		r1cs_variable_assignment<FieldT> full_assignment = GetVariableAssignment();
+		cout << "call GetVariableAssignment success..." << endl;
+
+		// drop the variables eliminated at key generation
+		if (!g_vectRemovedVars.empty())
+			full_assignment = r1cs_project_assignment(full_assignment, g_vectRemovedVars);
+
+		// get primary and auxiliary input
+		Primary.assign(full_assignment.begin(), full_assignment.begin() + NumInputs);
+		Auxiliary.assign(full_assignment.begin() + NumInputs, full_assignment.end());
+	}
+
   unsigned char GenerateResult(int64_t RetIndex, char *pResult, unsigned resSize){
 
     long RetValue = gadget_getVar(RetIndex);
@@ -349,6 +804,7 @@ extern "C"
 		assert(pInput);
 		assert(pOutput);
 		cout << "Verify param, input:" << pInput << ", result " << pOutput << endl;
+		ApplyThreadBudget();
 
 		// Initialize prime field parameters. This is always needed for R1P.
 		initPublicParamsFromDefaultPp();
@@ -378,14 +834,24 @@ extern "C"
 		vectVal.clear();
 		cout << "Real primary (public) input: " << pinput << endl;
 		
+		// the vk's tag selects the proof system
+		string strvk = pVKEY;
+		string strProof = pPoorf;
+		std::istringstream istrTag(strvk);
+		if (ReadProofSystemTag(istrTag) == PS_GROTH16) {
+			r1cs_gg_ppzksnark_verification_key<default_r1cs_gg_ppzksnark_pp> vk;
+			Deserial_gg_vkey(vk, strvk);
+			r1cs_gg_ppzksnark_proof<default_r1cs_gg_ppzksnark_pp> proof;
+			Deserial_gg_proof(proof, strProof);
+			return r1cs_gg_ppzksnark_verifier_strong_IC(vk, pinput, proof);
+		}
+
 		// deserialization vk
 		r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> vk;
-		string strvk = pVKEY;
 		Deserial_vkey(vk, strvk);
 		
 		// deserialization proof
 		r1cs_ppzksnark_proof<default_r1cs_ppzksnark_pp> proof;
-		string strProof = pPoorf;
 		Deserial_proof(proof, strProof);
 					
 		// cal libsnark verify and reture
@@ -415,7 +881,14 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-      auto mulGadget = MUL_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		uint64 constVal = 0;
+		GadgetPtr mulGadget;
+		if (GetConstVal(pNode->Input[1], constVal))
+			mulGadget = MULConst_Gadget::create(g_pbp, *plhsVar, (long)constVal, *presVar);
+		else if (GetConstVal(pNode->Input[0], constVal))
+			mulGadget = MULConst_Gadget::create(g_pbp, *prhsVar, (long)constVal, *presVar);
+		else
+			mulGadget = MUL_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(mulGadget);
 	}
 
@@ -442,7 +915,13 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-    	auto divGadget = UDIV_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		uint64 constVal = 0;
+		GadgetPtr divGadget;
+		if (GetConstVal(pNode->Input[1], constVal) && constVal != 0 &&
+			(UDivisionConst_Gadget::isPowerOfTwo(constVal) || constVal <= LONG_MAX))
+			divGadget = UDivisionConst_Gadget::create(g_pbp, *plhsVar, constVal, *presVar, Variable(GADGET_NAME("R")));
+		else
+			divGadget = UDIV_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(divGadget);
 	}
 
@@ -451,31 +930,31 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-    	auto modGadget = UREM_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		uint64 constVal = 0;
+		GadgetPtr modGadget;
+		if (GetConstVal(pNode->Input[1], constVal) && constVal != 0 &&
+			(UDivisionConst_Gadget::isPowerOfTwo(constVal) || constVal <= LONG_MAX))
+			modGadget = UDivisionConst_Gadget::create(g_pbp, *plhsVar, constVal, Variable(GADGET_NAME("Q")), *presVar);
+		else
+			modGadget = UREM_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(modGadget);
 	}
 
 	/// create logic and gadget
 	void CreateAndGadget(SSA_Node* pNode) {
-		VariableArray vaInput;
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		vaInput.emplace_back(*plhsVar);
-		vaInput.emplace_back(*prhsVar);
-		auto andGadget = AND_Gadget::create(g_pbp, vaInput, *presVar);
+		auto andGadget = LOGIC_Gadget::create(g_pbp, *plhsVar, *prhsVar, false, *presVar);
 		g_vectGadgets.emplace_back(andGadget);
 	}
 
 	/// create logic or gadget
 	void CreateOrGadget(SSA_Node* pNode) {
-		VariableArray vaInput;
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		vaInput.emplace_back(*plhsVar);
-		vaInput.emplace_back(*prhsVar);
-		auto orGadget = OR_Gadget::create(g_pbp, vaInput, *presVar);
+		auto orGadget = LOGIC_Gadget::create(g_pbp, *plhsVar, *prhsVar, true, *presVar);
 		g_vectGadgets.emplace_back(orGadget);
 	}
 
@@ -553,7 +1032,14 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		auto eqGadget = EQ_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		uint64 constVal = 0;
+		GadgetPtr eqGadget;
+		if (GetConstVal(pNode->Input[1], constVal))
+			eqGadget = EQConst_Gadget::create(g_pbp, *plhsVar, (long)constVal, false, *presVar);
+		else if (GetConstVal(pNode->Input[0], constVal))
+			eqGadget = EQConst_Gadget::create(g_pbp, *prhsVar, (long)constVal, false, *presVar);
+		else
+			eqGadget = EQ_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(eqGadget);
 	}
 
@@ -562,7 +1048,14 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		auto neqGadget = NEQ_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		uint64 constVal = 0;
+		GadgetPtr neqGadget;
+		if (GetConstVal(pNode->Input[1], constVal))
+			neqGadget = EQConst_Gadget::create(g_pbp, *plhsVar, (long)constVal, true, *presVar);
+		else if (GetConstVal(pNode->Input[0], constVal))
+			neqGadget = EQConst_Gadget::create(g_pbp, *prhsVar, (long)constVal, true, *presVar);
+		else
+			neqGadget = NEQ_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(neqGadget);
 	}
 
@@ -571,7 +1064,9 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		auto sgtGadget = SGT_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		GadgetPtr sgtGadget = CreateCmpConstGadget(pNode, true, false);
+		if (!sgtGadget)
+			sgtGadget = SGT_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(sgtGadget);
 	}
 
@@ -580,7 +1075,9 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		auto sgeGadget = SGE_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		GadgetPtr sgeGadget = CreateCmpConstGadget(pNode, true, true);
+		if (!sgeGadget)
+			sgeGadget = SGE_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(sgeGadget);
 	}
 
@@ -589,7 +1086,9 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		auto ugtGadget = UGT_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		GadgetPtr ugtGadget = CreateCmpConstGadget(pNode, false, false);
+		if (!ugtGadget)
+			ugtGadget = UGT_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(ugtGadget);
 	}
 
@@ -598,10 +1097,53 @@ extern "C"
 		Variable *plhsVar = (Variable*)(pNode->Input[0]);
 		Variable *prhsVar = (Variable*)(pNode->Input[1]);
 		Variable *presVar = (Variable*)(pNode->Result);
-		auto ugeGadget = UGE_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
+		GadgetPtr ugeGadget = CreateCmpConstGadget(pNode, false, true);
+		if (!ugeGadget)
+			ugeGadget = UGE_Gadget::create(g_pbp, *plhsVar, *prhsVar, *presVar);
 		g_vectGadgets.emplace_back(ugeGadget);
 	}
 
+	/// create pow gadget, result = base ^ exp wrapping on 64 bits
+	void CreatePowGadget(SSA_Node* pNode) {
+		Variable *pbaseVar = (Variable*)(pNode->Input[0]);
+		Variable *pexpVar  = (Variable*)(pNode->Input[1]);
+		Variable *presVar  = (Variable*)(pNode->Result);
+		uint64 expVal = 0;
+		bool isExpConst = GetConstVal(pNode->Input[1], expVal);
+		// modulus 2^64, the modulus variable is unused
+		auto powGadget = POWMOD_Gadget::create(g_pbp, *pbaseVar, *pexpVar, *pexpVar, *presVar,
+		                                       isExpConst, expVal, true, 0);
+		g_vectGadgets.emplace_back(powGadget);
+	}
+
+	/// create powmod gadget, result = base ^ exp % mod
+	void CreatePowModGadget(SSA_Node* pNode) {
+		Variable *pbaseVar = (Variable*)(pNode->Input[0]);
+		Variable *pexpVar  = (Variable*)(pNode->Input[1]);
+		Variable *pmodVar  = (Variable*)(pNode->Input[2]);
+		Variable *presVar  = (Variable*)(pNode->Result);
+		uint64 expVal = 0, modVal = 0;
+		bool isExpConst = GetConstVal(pNode->Input[1], expVal);
+		// a zero modulus, constant or not, is 2^64: the wrapping power of G_POW
+		bool isModConst = GetConstVal(pNode->Input[2], modVal);
+		auto powmodGadget = POWMOD_Gadget::create(g_pbp, *pbaseVar, *pexpVar, *pmodVar, *presVar,
+		                                          isExpConst, expVal, isModConst, modVal);
+		g_vectGadgets.emplace_back(powmodGadget);
+	}
+
+	/// create compare gadget against a constant operand, nullptr if both operands are variables
+	GadgetPtr CreateCmpConstGadget(SSA_Node* pNode, bool isSigned, bool orEqual) {
+		Variable *plhsVar = (Variable*)(pNode->Input[0]);
+		Variable *prhsVar = (Variable*)(pNode->Input[1]);
+		Variable *presVar = (Variable*)(pNode->Result);
+		uint64 constVal = 0;
+		if (GetConstVal(pNode->Input[1], constVal))
+			return CMPConst_Gadget::create(g_pbp, *plhsVar, constVal, isSigned, orEqual, false, *presVar);
+		if (GetConstVal(pNode->Input[0], constVal))
+			return CMPConst_Gadget::create(g_pbp, *prhsVar, constVal, isSigned, orEqual, true, *presVar);
+		return nullptr;
+	}
+
 	/// create ssa node
 	SSA_Node* CreateSSANode(int64_t input0, int64_t input1, int64_t input2, int64_t result, int32 Type) {		
 		// create SSA_Node
@@ -632,30 +1174,342 @@ extern "C"
 		// return SSA_Node
 		return pNode;
 	}
-	
+
+	/// enable or disable common subexpression elimination(default disable). The
+	/// shared gadgets are not created, which renumbers the later pb variables:
+	/// keys generated without cse do not fit a witness built with it
+	void gadget_setCSE(unsigned char enable) {
+		g_bCSE = (enable != 0);
+	}
+
+	/// enable or disable constraint annotations and variable names(default enable,
+	/// no effect when built with CSNARK_NO_ANNOTATIONS)
+	void gadget_setAnnotations(unsigned char enable) {
+		setAnnotations(enable != 0);
+	}
+
+	/// build the (type, width, inputs) key of a gadget and alias result to the
+	/// result of an identical gadget if there is one. Key stays empty if the
+	/// gadget can't be shared.
+	bool FindCommonGadget(int64_t input0, int64_t input1, int64_t input2, int64_t result, int32 Type, vector<uint64> &Key) {
+		// a pre-created result may be a public input/output, keep its own gadget
+		if (!g_bCSE || g_mapVar.find((void *)result) != g_mapVar.end())
+			return false;
+
+		const int64_t Inputs[3] = {input0, input1, input2};
+		vector<pair<uint64, uint64> > vectOperand;
+		for (int32 i = 0; i < GetInputCount(Type); i++) {
+			uint64 pVar = gadget_createPBVar(Inputs[i]);
+			uint64 Val = 0;
+			if (GetConstVal(pVar, Val))
+				vectOperand.emplace_back(1, Val);
+			else
+				vectOperand.emplace_back(0, pVar);
+		}
+
+		// commutative operations
+		switch (Type) {
+			case G_ADD:
+			case G_MUL:
+			case G_AND:
+			case G_OR:
+			case G_BITW_OR:
+			case G_BITW_XOR:
+			case G_BITW_AND:
+			case G_EQ:
+			case G_NEQ:
+			if (vectOperand[1] < vectOperand[0])
+				swap(vectOperand[0], vectOperand[1]);
+			break;
+		}
+
+		Key.emplace_back((uint64)Type);
+		for (auto &Operand : vectOperand) {
+			Key.emplace_back(Operand.first);
+			Key.emplace_back(Operand.second);
+		}
+		// source and destination width
+		if (Type == G_TRUNC || Type == G_ZEXT || Type == G_SEXT) {
+			Key.emplace_back((uint64)input1);
+			Key.emplace_back((uint64)input2);
+		}
+
+		map<vector<uint64>, Variable*>::iterator it = g_mapCSE.find(Key);
+		if (it == g_mapCSE.end())
+			return false;
+
+		g_mapVar[(void *)result] = it->second;
+		++g_Stats.CseHits;
+		return true;
+	}
+
+	/// number of pb variable inputs of a ssa node
+	int32 GetInputCount(int32 Type) {
+		switch (Type) {
+			case G_NOT:
+			case G_TRUNC:
+			case G_ZEXT:
+			case G_SEXT:
+			return 1;
+
+			case G_SELECT:
+			case G_POWMOD:
+			return 3;
+
+			default:
+			return 2;
+		}
+	}
+
+	/// mark the gadgets the return value, the declared outputs and the public
+	/// variables depend on. Public are the variables marked by gadget_setPublicVar
+	/// and the first g_PrimaryInputs pb variables; every gadget is live if neither
+	/// a return value nor an output was declared
+	void MarkLiveGadgets() {
+		const size_t Count = g_vectGadgets.size();
+		vector<uint64> vectWork(g_vectOutputs);
+		map<void*, Variable*>::iterator it = g_mapVar.find((void *)g_RetIndex);
+		if (g_RetIndex && it != g_mapVar.end())
+			vectWork.emplace_back((uint64)it->second);
+
+		g_Stats.Gadgets = Count;
+		g_Stats.DroppedGadgets = 0;
+		if (vectWork.empty()) {
+			g_vectLive.assign(Count, true);
+			return;
+		}
+
+		// a public variable without its gadget would take any value in a proof
+		for (auto &Var : g_vectCircuitVars)
+			if (Var.Flags & CIRCUIT_VAR_PUBLIC)
+				vectWork.emplace_back((uint64)g_mapVar[(void *)Var.Id]);
+		for (auto &ItemV : g_mapVar)
+			if (GadgetLibAdapter::getVariableIndex(*ItemV.second) < g_PrimaryInputs)
+				vectWork.emplace_back((uint64)ItemV.second);
+
+		// result variable -> producing gadgets
+		map<uint64, vector<size_t> > mapProducer;
+		for (size_t i = 0; i < Count; i++)
+			mapProducer[g_vectNodes[i]->Result].emplace_back(i);
+
+		g_vectLive.assign(Count, false);
+		set<uint64> setVisited;
+		while (!vectWork.empty()) {
+			uint64 pVar = vectWork.back();
+			vectWork.pop_back();
+			if (!setVisited.insert(pVar).second)
+				continue;
+
+			map<uint64, vector<size_t> >::iterator itP = mapProducer.find(pVar);
+			if (itP == mapProducer.end())
+				continue;
+			for (auto Index : itP->second) {
+				if (g_vectLive[Index])
+					continue;
+				g_vectLive[Index] = true;
+				SSA_Node *pNode = g_vectNodes[Index];
+				for (int32 i = 0; i < GetInputCount(pNode->type); i++)
+					vectWork.emplace_back(pNode->Input[i]);
+			}
+		}
+
+		for (size_t i = 0; i < Count; i++)
+			if (!g_vectLive[i])
+				++g_Stats.DroppedGadgets;
+		DBG_MSG("dead gadget elimination: %llu of %lu gadgets dropped\n", g_Stats.DroppedGadgets, Count);
+	}
+
+	/// the public input count is known only when a key is generated or used: make
+	/// the gadgets of the first NumInputs pb variables live and generate the
+	/// constraints (or, bWitness, the witness) of the live gadgets not in vectDone
+	void ReviveInputGadgets(size_t NumInputs, vector<bool> &vectDone, bool bWitness) {
+		if (NumInputs > g_PrimaryInputs) {
+			g_PrimaryInputs = NumInputs;
+			MarkLiveGadgets();
+		}
+		if (vectDone.size() != g_vectGadgets.size() || vectDone == g_vectLive)
+			return;
+
+		DenseProtoboard *pDense = bWitness ? BuildWitnessTape() : nullptr;
+		for (size_t i = 0; i < g_vectGadgets.size(); i++) {
+			if (!g_vectLive[i] || vectDone[i])
+				continue;
+			// ssa order, a revived gadget's inputs are already computed
+			vectDone[i] = true;
+			if (bWitness) {
+				g_tape.run(*pDense, i);
+				continue;
+			}
+			g_vectGadgets[i]->generateConstraints();
+			g_Stats.DroppedConstraints -= dynamic_cast<const DenseGadget&>(*g_vectGadgets[i]).numConstraints();
+		}
+	}
+
+	/// group the live gadgets by ssa dependency depth, the gadgets of one level are
+	/// independent of each other. Also sizes the dense protoboard and tracks every
+	/// ssa variable so that parallel witness generation never grows it.
+	void GetWitnessLevels(vector<vector<size_t> > &vectLevels) {
+		DenseProtoboard::find(g_pbp)->reserve();
+
+		map<uint64, size_t> mapWritten;	// variable -> level after its writer
+		map<uint64, size_t>::iterator it;
+		for (size_t i = 0; i < g_vectGadgets.size(); i++) {
+			if (!g_vectLive[i])
+				continue;
+			SSA_Node *pNode = g_vectNodes[i];
+			const int32 Inputs = GetInputCount(pNode->type);
+
+			// read after write; every variable has a single writer
+			size_t Level = 0;
+			for (int32 k = 0; k < Inputs; k++)
+				if ((it = mapWritten.find(pNode->Input[k])) != mapWritten.end())
+					Level = max(Level, it->second);
+
+			if (vectLevels.size() <= Level)
+				vectLevels.resize(Level + 1);
+			vectLevels[Level].emplace_back(i);
+			mapWritten[pNode->Result] = Level + 1;
+			for (int32 k = 0; k < Inputs; k++)
+				PBVal(*(Variable*)pNode->Input[k]);
+			PBVal(*(Variable*)pNode->Result);
+		}
+		DBG_MSG("witness levels: %lu\n", vectLevels.size());
+	}
+
+	/// (re)build the witness tape when gadgets were added since the last witness;
+	/// a loaded witness function was generated for the old tape and is dropped
+	DenseProtoboard* BuildWitnessTape() {
+		DenseProtoboard *pDense = DenseProtoboard::find(g_pbp);
+		if (g_tape.size() != g_vectGadgets.size()) {
+			g_pfnWitness = nullptr;
+			g_tape.clear();
+			for (auto &pGadget : g_vectGadgets)
+				g_tape.append(*pDense, pGadget);
+		}
+		return pDense;
+	}
+
+	/// generateConstraints of the live gadgets. Under MULTICORE every gadget records
+	/// into its own buffer in parallel and the buffers are replayed in gadget order,
+	/// so the constraint system (and the keys) match a serial build. The gadgets go
+	/// in chunks of GadgetsPerThread per thread: at most one chunk of recorded
+	/// constraints is held besides the constraint system.
+	void GenerateGadgetConstraints() {
+#ifdef MULTICORE
+		const size_t GadgetsPerThread = 256;
+		const size_t Count = g_vectGadgets.size();
+		vector<DenseProtoboard::ConstraintBuffer> vectBuffers(min(Count, GadgetsPerThread * omp_get_max_threads()));
+		DenseProtoboard *pDense = DenseProtoboard::find(g_pbp);
+		for (size_t First = 0; First < Count; First += vectBuffers.size()) {
+			const long Chunk = min(vectBuffers.size(), Count - First);
+			#pragma omp parallel for schedule(dynamic)
+			for (long i = 0; i < Chunk; i++) {
+				if (!g_vectLive[First + i])
+					continue;
+				DenseProtoboard::Recorder recorder(vectBuffers[i]);
+				g_vectGadgets[First + i]->generateConstraints();
+			}
+			for (long i = 0; i < Chunk; i++) {
+				pDense->replay(vectBuffers[i]);
+				vectBuffers[i].clear();
+			}
+		}
+#else
+		for (size_t i = 0; i < g_vectGadgets.size(); i++)
+			if (g_vectLive[i])
+				g_vectGadgets[i]->generateConstraints();
+#endif
+	}
+
+	/// lookup constant value of a pb variable
+	bool GetConstVal(uint64 pVar, uint64 &Val) {
+		map<Variable*, uint64>::iterator it = g_mapConst.find((Variable*)pVar);
+		if (it == g_mapConst.end())
+			return false;
+		Val = it->second;
+		return true;
+	}
+
+	/// value of a pb variable in the dense assignment of g_pbp
+	FlatRef PBVal(const Variable &var) {
+		return DenseProtoboard::find(g_pbp)->val(var);
+	}
+
+	/// libsnark full assignment straight from the dense values, the 64 bit shadows are
+	/// materialized in one pass; index 0 (ONE) excluded
+	r1cs_variable_assignment<FieldT> GetVariableAssignment() {
+		DenseProtoboard *pDense = DenseProtoboard::find(g_pbp);
+		pDense->materialize();
+		r1cs_variable_assignment<FieldT> result(GadgetLibAdapter::getNextFreeIndex(), FieldT::zero());
+		const long Count = min(pDense->size(), result.size());
+#ifdef MULTICORE
+		#pragma omp parallel for
+#endif
+		for (long i = 0; i < Count; i++)
+			result[i] = pDense->value(i).asFp();
+		return result;
+	}
+
 	/// serialization pkey
     void Serial_pkey(const r1cs_ppzksnark_proving_key<default_r1cs_ppzksnark_pp> &pk, std::string &pkey) {
         std::ostringstream ostr; 
-        ostr << pk;
+        ostr << ProofSystemTag(PS_PPZKSNARK) << pk;
+        Serial_removedVars(ostr);
         pkey = ostr.str();
     }
+
+    /// variables removed by the linear elimination, the tail of a pkey
+    void Serial_removedVars(std::ostream &ostr) {
+        ostr << g_vectRemovedVars.size() << "\n";
+        for (auto Index : g_vectRemovedVars)
+            ostr << Index << "\n";
+    }
+
+    /// optional removed variables list after a pkey, absent in legacy keys
+    void Deserial_removedVars(std::istream &istr) {
+        g_vectRemovedVars.clear();
+        size_t Count = 0;
+        if (istr >> Count) {
+            g_vectRemovedVars.resize(Count);
+            for (size_t i = 0; i < Count; i++)
+                istr >> g_vectRemovedVars[i];
+        }
+    }
+
+    /// first line of the serialized keys of a proof system
+    const char* ProofSystemTag(int32 ProofSystem) {
+        return ProofSystem == PS_GROTH16 ? "r1cs_gg_ppzksnark\n" : "r1cs_ppzksnark\n";
+    }
+
+    /// consume the tag of a serialized key; untagged legacy keys start with a
+    /// number and are r1cs_ppzksnark
+    int32 ReadProofSystemTag(std::istream &istr) {
+        if (istr.peek() != 'r')
+            return PS_PPZKSNARK;
+        string strTag;
+        getline(istr, strTag);
+        return strTag == "r1cs_gg_ppzksnark" ? PS_GROTH16 : PS_PPZKSNARK;
+    }
 	
 	/// deserialization pkey
 	void Deserial_pkey(r1cs_ppzksnark_proving_key<default_r1cs_ppzksnark_pp> &pk, const std::string &pkey) {
 		std::istringstream istr(pkey); 
+		ReadProofSystemTag(istr);
 		istr >> pk;
+		Deserial_removedVars(istr);
 	}
 
 	/// Serialization vkey
     void Serial_vkey(const r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> &vk, std::string &vkey) {
         std::ostringstream ostr; 
-        ostr << vk;
+        ostr << ProofSystemTag(PS_PPZKSNARK) << vk;
         vkey = ostr.str();
     }
 	
 	/// deserialization vkey
 	void Deserial_vkey(r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> &vk, const std::string &vkey) {
 		std::istringstream istr(vkey); 
+		ReadProofSystemTag(istr);
 		istr >> vk;
 	}
 	
@@ -672,6 +1526,49 @@ extern "C"
 		istr >> r1cs_proof;
 	}
 
+	/// Serialization Groth16 pkey
+	void Serial_gg_pkey(const r1cs_gg_ppzksnark_proving_key<default_r1cs_gg_ppzksnark_pp> &pk, std::string &pkey) {
+		std::ostringstream ostr; 
+		ostr << ProofSystemTag(PS_GROTH16) << pk;
+		Serial_removedVars(ostr);
+		pkey = ostr.str();
+	}
+
+	/// deserialization Groth16 pkey
+	void Deserial_gg_pkey(r1cs_gg_ppzksnark_proving_key<default_r1cs_gg_ppzksnark_pp> &pk, const std::string &pkey) {
+		std::istringstream istr(pkey); 
+		ReadProofSystemTag(istr);
+		istr >> pk;
+		Deserial_removedVars(istr);
+	}
+
+	/// Serialization Groth16 vkey
+	void Serial_gg_vkey(const r1cs_gg_ppzksnark_verification_key<default_r1cs_gg_ppzksnark_pp> &vk, std::string &vkey) {
+		std::ostringstream ostr; 
+		ostr << ProofSystemTag(PS_GROTH16) << vk;
+		vkey = ostr.str();
+	}
+
+	/// deserialization Groth16 vkey
+	void Deserial_gg_vkey(r1cs_gg_ppzksnark_verification_key<default_r1cs_gg_ppzksnark_pp> &vk, const std::string &vkey) {
+		std::istringstream istr(vkey); 
+		ReadProofSystemTag(istr);
+		istr >> vk;
+	}
+
+	/// serialization Groth16 proof
+	void Serial_gg_proof(const r1cs_gg_ppzksnark_proof<default_r1cs_gg_ppzksnark_pp> &r1cs_proof, std::string &proof) {
+		std::ostringstream ostr; 
+		ostr << r1cs_proof;
+		proof = ostr.str();
+	}
+
+	/// deserialization Groth16 proof
+	void Deserial_gg_proof(r1cs_gg_ppzksnark_proof<default_r1cs_gg_ppzksnark_pp> &r1cs_proof, const std::string &proof) {
+		std::istringstream istr(proof); 
+		istr >> r1cs_proof;
+	}
+
 	/// Serialization output
     void Serial_output(const FieldT output, std::string &strOutput) {
         std::ostringstream ostr; 
@@ -696,17 +1593,172 @@ extern "C"
 		}
 	}
 
-  void keypairGen(unsigned primary_input_size, std::string pkey, std::string vkey){
+  /// translate constraint system to libsnark format and run the linear elimination
+  void ExportConstraintSystem(unsigned primary_input_size, r1cs_constraint_system<FieldT> &cs){
+    // the live gadgets wrote their rows straight into the sparse r1cs, in
+    // generation order. Each row becomes an r1cs_constraint as it is, repeated
+    // rows (e.g. the booleanity of a shared bit) are dropped by hash
+    typedef GadgetLibAdapter GLA;
+    ReviveInputGadgets(primary_input_size, g_vectConstrained, false);
+    const SparseR1CS &R1CS = DenseProtoboard::find(g_pbp)->sparseR1CS();
+    auto convertRow = [](const SparseR1CS::Matrix &m, size_t row) {
+      linear_combination<FieldT> result;
+      for (size_t k = m.rowStart[row]; k < m.rowStart[row + 1]; k++)
+        result.add_term(m.cols[k], m.coeffs[k]);
+      return result;
+    };
+
+    cs = r1cs_constraint_system<FieldT>();
+    cs.constraints.reserve(R1CS.numConstraints());
+    unordered_multimap<size_t, size_t> mapRows;	// row hash -> exported row
+    mapRows.reserve(R1CS.numConstraints());
+    for (size_t row = 0; row < R1CS.numConstraints(); row++) {
+      const size_t hash = R1CS.hashRow(row);
+      auto range = mapRows.equal_range(hash);
+      bool bSeen = false;
+      for (auto it = range.first; it != range.second && !bSeen; ++it)
+        bSeen = R1CS.sameRow(it->second, row);
+      if (bSeen)
+        continue;
+      mapRows.emplace(hash, row);
+      cs.add_constraint(r1cs_constraint<FieldT>(convertRow(R1CS.A, row),
+                                                convertRow(R1CS.B, row),
+                                                convertRow(R1CS.C, row)));
+    }
+    cs.primary_input_size = primary_input_size;
+    cs.auxiliary_input_size = GLA::getNextFreeIndex() - primary_input_size;
+
+    g_Stats.EliminatedConstraints = 0;
+    if (g_bLinearElim)
+      g_Stats.EliminatedConstraints = r1cs_eliminate_linear(cs, g_vectRemovedVars);
+    else
+      r1cs_remove_unused(cs, g_vectRemovedVars);
+    g_Stats.RemovedVars = g_vectRemovedVars.size();
+    DBG_MSG("linear elimination: %llu constraints, %llu variables removed\n",
+            g_Stats.EliminatedConstraints, g_Stats.RemovedVars);
+  }
+
+  /// enable or disable linear constraint elimination(default enable)
+  void gadget_setLinearElimination(unsigned char enable){
+    g_bLinearElim = (enable != 0);
+  }
+
+  void keypairGen(unsigned primary_input_size, std::string &pkey, std::string &vkey, int32 ProofSystem){
 
     // translate constraint system to libsnark format.
-    r1cs_constraint_system<FieldT> cs = get_constraint_system_from_gadgetlib2(*g_pbp);
-    cs.primary_input_size = primary_input_size;  //num:3 must be replace $input_output count$
-    cs.auxiliary_input_size -= cs.primary_input_size;
+    ApplyThreadBudget();
+    r1cs_constraint_system<FieldT> cs;
+    ExportConstraintSystem(primary_input_size, cs);  //num:3 must be replace $input_output count$
 
     // generate key pair
+    if (ProofSystem == PS_GROTH16) {
+      r1cs_gg_ppzksnark_keypair<default_r1cs_gg_ppzksnark_pp> keyPair = r1cs_gg_ppzksnark_generator<default_r1cs_gg_ppzksnark_pp>(cs);
+      Serial_gg_pkey(keyPair.pk, pkey);
+      Serial_gg_vkey(keyPair.vk, vkey);
+      return;
+    }
     r1cs_ppzksnark_keypair<default_r1cs_ppzksnark_pp> keyPair = r1cs_ppzksnark_generator<default_r1cs_ppzksnark_pp>(cs);
     Serial_pkey(keyPair.pk, pkey);
     Serial_vkey(keyPair.vk, vkey);
   }
+
+  /// key generation for an exported cs writing the pkey straight to pPKPath, with at
+  /// most about memoryLimit bytes of key elements in memory (see keygen.hpp).
+  /// With pCheckpoint every finished pkey section is checkpointed there, encrypted
+  /// under pPassphrase, and a run for the same cs (same r1cs fingerprint) resumes
+  /// after the last one. The checkpoint holds the toxic waste: it is securely
+  /// deleted once the keys are written unless bKeepCheckpoint.
+  /// Groth16 keys are generated in memory by r1cs_gg_ppzksnark_generator, without checkpoints
+  bool keypairGenToFile(r1cs_constraint_system<FieldT> &cs, const char *pPKPath, std::string &vkey, size_t memoryLimit,
+                        const char *pCheckpoint, const char *pPassphrase, bool bKeepCheckpoint, int32 ProofSystem){
+    assert(!pCheckpoint || pPassphrase);
+    ApplyThreadBudget();
+    if (ProofSystem == PS_GROTH16) {
+      std::ofstream pk(pPKPath, std::ios::binary);
+      if (!pk.is_open()) {
+        cout << "can't open " << pPKPath << endl;
+        return false;
+      }
+      r1cs_gg_ppzksnark_keypair<default_r1cs_gg_ppzksnark_pp> keyPair = r1cs_gg_ppzksnark_generator<default_r1cs_gg_ppzksnark_pp>(cs);
+      pk << ProofSystemTag(PS_GROTH16) << keyPair.pk;
+      Serial_removedVars(pk);
+      Serial_gg_vkey(keyPair.vk, vkey);
+      return pk.good();
+    }
+
+    // the generator swaps A and B of cs, fingerprint it before
+    const std::string fingerprint = pCheckpoint ? r1cs_fingerprint(cs, g_vectRemovedVars, ProofSystemTag(PS_PPZKSNARK)) : std::string();
+    keygen_state state;
+    struct stat st;
+    const bool bResume = pCheckpoint && keygen_checkpoint_load(pCheckpoint, pPassphrase, state)
+                         && state.fingerprint == fingerprint
+                         && state.num_constraints == cs.num_constraints() && state.num_inputs == cs.num_inputs()
+                         && state.num_variables == cs.num_variables()
+                         && stat(pPKPath, &st) == 0 && (uint64)st.st_size >= state.offset
+                         && truncate(pPKPath, state.offset) == 0;
+    if (bResume) {
+      cout << "resume key generation after " << state.sections << " pkey sections" << endl;
+    } else {
+      if (pCheckpoint && access(pCheckpoint, F_OK) == 0)
+        cout << "checkpoint " << pCheckpoint << " does not match, start over" << endl;
+      state = keygen_state();
+      state.fingerprint = fingerprint;
+    }
+
+    std::fstream pk(pPKPath, bResume ? std::ios::in | std::ios::out | std::ios::binary
+                                     : std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!pk.is_open()) {
+      cout << "can't open " << pPKPath << endl;
+      return false;
+    }
+    pk.seekp(0, std::ios::end);
+    if (!bResume)
+      pk << ProofSystemTag(PS_PPZKSNARK);
+
+    keygen_progress progress;
+    if (pCheckpoint)
+      progress = [&](const keygen_state &s) {
+        if (!keygen_checkpoint_save(pCheckpoint, pPassphrase, s))
+          cout << "write checkpoint " << pCheckpoint << " fail" << endl;
+      };
+    r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> vk = r1cs_ppzksnark_generator_to_stream(cs, pk, memoryLimit, &state, progress);
+    Serial_removedVars(pk);
+    Serial_vkey(vk, vkey);
+    const bool ok = pk.good();
+    if (ok && pCheckpoint && !bKeepCheckpoint && !secure_wipe(pCheckpoint))
+      cout << "wipe checkpoint " << pCheckpoint << " fail" << endl;
+    return ok;
+  }
+
+  /// canonical fingerprint of an exported cs keyed for ProofSystem (see keystore.hpp)
+  void R1CSFingerprint(const r1cs_constraint_system<FieldT> &cs, int32 ProofSystem, std::string &fingerprint){
+    fingerprint = r1cs_fingerprint(cs, g_vectRemovedVars, ProofSystemTag(ProofSystem));
+  }
+
+  /// fingerprint of the r1cs of the generated constraints as keypairGen exports and
+  /// keys it for ProofSystem, 64 hex digits and the terminating zero
+  unsigned char gadget_getFingerprint(unsigned primary_input_size, int32 ProofSystem, char *pFingerprint, unsigned size){
+    assert(pFingerprint);
+    r1cs_constraint_system<FieldT> cs;
+    ExportConstraintSystem(primary_input_size, cs);
+    string strFingerprint;
+    R1CSFingerprint(cs, ProofSystem, strFingerprint);
+    if (size <= strFingerprint.size())
+      return false;
+    strcpy(pFingerprint, strFingerprint.c_str());
+    return true;
+  }
+
+  /// copy the key pair of pFingerprint from the key store directory pStore (1 if found)
+  unsigned char gadget_fetchKeys(const char *pStore, const char *pFingerprint, const char *pPKPath, const char *pVKPath){
+    assert(pStore && pFingerprint && pPKPath && pVKPath);
+    return key_store(pStore).fetch(pFingerprint, pPKPath, pVKPath);
+  }
+
+  /// add a generated key pair to the key store directory pStore under pFingerprint
+  unsigned char gadget_storeKeys(const char *pStore, const char *pFingerprint, const char *pPKPath, const char *pVKPath){
+    assert(pStore && pFingerprint && pPKPath && pVKPath);
+    return key_store(pStore).store(pFingerprint, pPKPath, pVKPath);
+  }
 };
 
@@ -14,6 +14,51 @@ typedef struct tagNode {
 	uint64 Result;
 }SSA_Node;	
 
+typedef struct tagGadgetStats {
+	uint64 Gadgets;
+	uint64 DroppedGadgets;
+	uint64 DroppedConstraints;
+	uint64 DroppedVars;
+	uint64 CseHits;
+	uint64 EliminatedConstraints;
+	uint64 RemovedVars;
+}Gadget_Stats;
+
+/// binary circuit IR written by gadget_saveCircuit, little endian: the header,
+/// then VarCount Circuit_Var, ConstCount Circuit_Const, NodeCount Circuit_Node
+/// and OutputCount int64 variable ids. Variables are declared in creation order;
+/// gadget_loadCircuit declares the public ones first, they are the primary input.
+#define CIRCUIT_MAGIC		0x52495343		// "CSIR"
+#define CIRCUIT_VERSION		1
+#define CIRCUIT_VAR_PUBLIC	1
+
+typedef struct tagCircuitHeader {
+	uint32 Magic;
+	uint32 Version;
+	uint64 VarCount;
+	uint64 ConstCount;
+	uint64 NodeCount;
+	uint64 OutputCount;
+	int64  RetIndex;
+}Circuit_Header;
+
+typedef struct tagCircuitVar {
+	int64  Id;
+	uint64 Flags;
+}Circuit_Var;
+
+typedef struct tagCircuitConst {
+	int64  Id;
+	int64  Val;
+}Circuit_Const;
+
+typedef struct tagCircuitNode {
+	int32  type;
+	uint32 Reserved;
+	int64  Input[3];
+	int64  Result;
+}Circuit_Node;
+
 typedef enum eType {
 	G_ADD  = 0,
 	G_SUB,
@@ -38,24 +83,50 @@ typedef enum eType {
 	G_SGE,
 	G_UGT,
 	G_UGE,
+	G_POW,
+	G_POWMOD,
 }E_GType;
 
+/// proof system of a key pair, tagged in the serialized keys
+typedef enum eProofSystem {
+	PS_PPZKSNARK = 0,	// r1cs_ppzksnark (BCTV14), also untagged legacy keys
+	PS_GROTH16,			// r1cs_gg_ppzksnark (Groth16)
+}E_ProofSystem;
+
 
 extern "C" 
 {
 	void gadget_initEnv();
 	void gadget_uninitEnv();
+	int csnark_set_threads(int n);
 
 
 	uint64 gadget_createPBVar(int64_t ptr);
 	unsigned char gadget_createGadget(int64_t input0, int64_t input1, int64_t input2, int64_t result, int32 Type);
 	void gadget_setVar(int64_t ptr, int64 Val, unsigned char is_unsigned);
+	void gadget_setConstVar(int64_t ptr, int64 Val);
 	long gadget_getVar(int64_t ptr);
 	void gadget_setRetIndex(int64_t ptr);
+	void gadget_addOutput(int64_t ptr);
+	void gadget_setPublicVar(int64_t ptr);
+	unsigned gadget_getPublicVarCount();
+	unsigned char gadget_checkPublicVars();
+	unsigned char gadget_saveCircuit(const char *pPath);
+	unsigned char gadget_loadCircuit(const char *pPath);
+	void gadget_getStats(Gadget_Stats *pStats);
 
 
 	void gadget_generateConstraints();
+	void gadget_setLinearElimination(unsigned char enable);
+	void gadget_setCSE(unsigned char enable);
+	void gadget_setAnnotations(unsigned char enable);
 	void gadget_generateWitness();
+	void gadget_regenerateWitness();
+	unsigned char gadget_emitWitnessCode(const char *pPath, const char *pSymbol);
+	unsigned char gadget_loadWitnessCode(const char *pPath, const char *pSymbol);
+	unsigned char gadget_getFingerprint(unsigned primary_input_size, int32 ProofSystem, char *pFingerprint, unsigned size);
+	unsigned char gadget_fetchKeys(const char *pStore, const char *pFingerprint, const char *pPKPath, const char *pVKPath);
+	unsigned char gadget_storeKeys(const char *pStore, const char *pFingerprint, const char *pPKPath, const char *pVKPath);
 	unsigned char GenerateProof(const char *pPKEY, char *pProof, unsigned prSize);
   unsigned char GenerateResult(int64_t RetIndex, char *pResult, unsigned resSize);
 
@@ -5,6 +5,12 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <libff/common/profiling.hpp>
 #include <libff/common/utils.hpp>
@@ -26,74 +32,240 @@ typedef libff::Fr<libff::default_ec_pp> FieldT;
 
 /// libcsnark function decl
 extern "C" ProtoboardPtr g_pbp;
-extern "C" void Serial_pkey(const r1cs_ppzksnark_proving_key<default_r1cs_ppzksnark_pp> &pk, std::string &pkey);
-extern "C" void Serial_vkey(const r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> &vk, std::string &vkey);
+extern "C" void ExportConstraintSystem(unsigned primary_input_size, r1cs_constraint_system<FieldT> &cs);
+extern "C" bool keypairGenToFile(r1cs_constraint_system<FieldT> &cs, const char *pPKPath, std::string &vkey, size_t memoryLimit,
+                                 const char *pCheckpoint, const char *pPassphrase, bool bKeepCheckpoint, int32 ProofSystem);
+extern "C" void R1CSFingerprint(const r1cs_constraint_system<FieldT> &cs, int32 ProofSystem, std::string &fingerprint);
 
 
-/// VKEY & PKEY generator
-bool GenerateKeypair() {
-    // gadget init
-    gadget_initEnv();
+/// command line options
+struct Options {
+    int publicInputs = -1;      // -1: the public variables marked in the circuit file
+    unsigned jobs = 1;          // circuits keyed in parallel (one process each)
+    int threads = 0;            // threads per circuit, 0: all cores
+    size_t memoryLimit = 256;   // MB of proving key elements computed at a time
+    bool checkpoint = false;    // checkpoint to <out_dir>/<name>.ckpt and resume from it
+    bool keepCheckpoint = false; // keep the checkpoint after success instead of wiping it
+    const char *passphrase = nullptr;
+    const char *store = nullptr;        // key store directory, -s or $CSNARK_KEY_STORE
+    int32 proofSystem = PS_PPZKSNARK;
+    string outDir = ".";
+    vector<string> circuits;
+};
 
-    // create gadgets. 
-    // the follow code must be auto generate by vc compiler
-    // $create_gadgets$
-    // create pb variables
-    gadget_createPBVar(1);
-//    gadget_createPBVar(2);
-    gadget_createPBVar(3);
-
-    // create gadget
-    if (!gadget_createGadget(1, 0, 0, 3, E_GType::G_NOT)) {
-        cout << "create or gadget fail." << endl;
-        return false;
+
+static void usage(const char *prog) {
+    cout << "usage: " << prog << " [-p public_inputs] [-j jobs] [-t threads] [-b backend] [-m MB] [-c [-k]] [-s store] [-o out_dir] circuit..." << endl
+         << "  circuit         file written by gadget_saveCircuit, keys go to <out_dir>/<name>.pk/.vk" << endl
+         << "  -p count        number of public inputs (default: variables marked public in the file)" << endl
+         << "  -j jobs         circuits keyed in parallel (default 1, the generator then uses all cores)" << endl
+         << "  -t threads      threads of each circuit's key generation (default all cores)" << endl
+         << "  -b backend      proof system: ppzksnark (BCTV14, default) or groth16" << endl
+         << "  -m MB           memory for proving key elements, the key is written as it is computed (default 256)" << endl
+         << "  -c              ppzksnark only: checkpoint to <out_dir>/<name>.ckpt, encrypted with $CSNARK_CHECKPOINT_KEY," << endl
+         << "                  and resume an interrupted run from it" << endl
+         << "  -k              keep the checkpoint when the keys are written (it is securely wiped by default)" << endl
+         << "  -s store        key store directory (default $CSNARK_KEY_STORE): keys of an identical" << endl
+         << "                  r1cs are copied from it, new keys are added to it" << endl
+         << "  -o out_dir      output directory (default .)" << endl;
+}
+
+
+/// peak resident memory of this process in MB
+static double peakMemoryMB(int who = RUSAGE_SELF) {
+    struct rusage usage;
+    getrusage(who, &usage);
+    return usage.ru_maxrss / 1024.0;        // KB on linux
+}
+
+
+/// prints the time since the last call under name
+class PhaseTimer {
+public:
+    explicit PhaseTimer(const string &circuit) : circuit_(circuit), start_(libff::get_nsec_time()) {}
+
+    void done(const char *phase) {
+        const long long now = libff::get_nsec_time();
+        cout << circuit_ << ": " << phase << " " << (now - start_) / 1000000 << " ms" << endl;
+        start_ = now;
     }
-    
-    // generate constraints.
-    gadget_generateConstraints();
 
-    // translate constraint system to libsnark format.
-    r1cs_constraint_system<FieldT> cs = get_constraint_system_from_gadgetlib2(*g_pbp);
-    cs.primary_input_size = 2;  //num:2 must be replace $input_output count$
-    cs.auxiliary_input_size -= cs.primary_input_size;
+private:
+    const string circuit_;
+    long long start_;
+};
 
-    // translate full variable assignment to libsnark format
-    const r1cs_variable_assignment<FieldT> full_assignment = get_variable_assignment_from_gadgetlib2(*g_pbp);
 
-    // extract primary and auxiliary input
-    const r1cs_primary_input<FieldT> primary_input(full_assignment.begin(), full_assignment.begin() + cs.num_inputs());
+/// write data byte for byte (keys are binary when libff is built with BINARY_OUTPUT)
+static bool writeFile(const string &path, const string &data) {
+    ofstream out(path, ios::binary);
+    if (!out.is_open()) {
+        cout << "can't open " << path << endl;
+        return false;
+    }
+    out.write(data.data(), data.size());
+    return out.good();
+}
+
+
+/// <out_dir>/<circuit file name without extension>
+static string keyBase(const Options &opts, const string &circuit) {
+    string name = circuit.substr(circuit.find_last_of('/') + 1);
+    const size_t dot = name.find_last_of('.');
+    if (dot != string::npos && dot > 0)
+        name.erase(dot);
+    return opts.outDir + "/" + name;
+}
 
-    // generate key pair
-    r1cs_ppzksnark_keypair<default_r1cs_ppzksnark_pp> keyPair = r1cs_ppzksnark_generator<default_r1cs_ppzksnark_pp>(cs);
 
-    // serial key pair
-    string pkey, vkey;
-    Serial_pkey(keyPair.pk, pkey);
-    Serial_vkey(keyPair.vk, vkey);
+/// VKEY & PKEY generator for one circuit file
+bool GenerateKeypair(const Options &opts, const string &circuit) {
+    PhaseTimer timer(circuit);
 
-    // write pkey & vkey data to file
-    std::fstream fpk, fvk;
-    fpk.open("./pk.txt", std::ios::out);
-    if (!fpk.is_open()) {
-        cout << "can't open ./pk.txt, generate pkey fail..." << endl;
+    // gadget init and circuit
+    gadget_initEnv();
+    csnark_set_threads(opts.threads);
+    if (!gadget_loadCircuit(circuit.c_str())) {
+        cout << "load circuit " << circuit << " fail." << endl;
+        gadget_uninitEnv();
         return false;
     }
-    fpk << pkey.c_str();
-    fpk.close();
-    cout << "generate pkey ok..." << endl;
-    fvk.open("./vk.txt", std::ios::out);
-    if (!fvk.is_open()) {
-        cout << "can't open ./vk.txt, generate vkey fail..." << endl;
+    const unsigned publicInputs = opts.publicInputs >= 0 ? opts.publicInputs : gadget_getPublicVarCount();
+    if (opts.publicInputs < 0 && !gadget_checkPublicVars()) {
+        cout << circuit << ": the public variables are not the first " << publicInputs << " variables" << endl;
+        gadget_uninitEnv();
         return false;
     }
-    fvk << vkey.c_str();
-    fvk.close();
-    cout << "generate vkey ok..." << endl;
-    
-    return true;    
+    timer.done("load circuit");
+
+    // generate constraints.
+    gadget_generateConstraints();
+    timer.done("constraints");
+
+    // translate constraint system to libsnark format, eliminate linear constraints.
+    r1cs_constraint_system<FieldT> cs;
+    ExportConstraintSystem(publicInputs, cs);
+    Gadget_Stats stats;
+    gadget_getStats(&stats);
+    cout << circuit << ": " << cs.num_constraints() << " constraints, " << cs.num_variables()
+         << " variables, " << publicInputs << " public inputs" << endl;
+    cout << circuit << ": linear elimination: " << stats.EliminatedConstraints << " constraints, "
+         << stats.RemovedVars << " variables removed" << endl;
+    timer.done("export");
+
+    // an identical r1cs was keyed before for the same proof system
+    const string base = keyBase(opts, circuit);
+    string fingerprint;
+    R1CSFingerprint(cs, opts.proofSystem, fingerprint);
+    cout << circuit << ": fingerprint " << fingerprint << endl;
+    if (opts.store && gadget_fetchKeys(opts.store, fingerprint.c_str(), (base + ".pk").c_str(), (base + ".vk").c_str())) {
+        timer.done("key store hit");
+        gadget_uninitEnv();
+        return true;
+    }
+
+    // generate key pair, the pkey goes to disk section by section
+    string vkey;
+    const string checkpoint = base + ".ckpt";
+    const bool ok = keypairGenToFile(cs, (base + ".pk").c_str(), vkey, opts.memoryLimit << 20,
+                                     opts.checkpoint ? checkpoint.c_str() : nullptr, opts.passphrase, opts.keepCheckpoint,
+                                     opts.proofSystem)
+                    && writeFile(base + ".vk", vkey);
+    timer.done("generator");
+    if (ok && opts.store && !gadget_storeKeys(opts.store, fingerprint.c_str(), (base + ".pk").c_str(), (base + ".vk").c_str()))
+        cout << circuit << ": add keys to " << opts.store << " fail" << endl;
+
+    gadget_uninitEnv();
+    cout << circuit << ": " << (ok ? "generate keys ok" : "generate keys fail")
+         << ", peak memory " << peakMemoryMB() << " MB" << endl;
+    return ok;
 }
 
 
-int main() {
-    return !GenerateKeypair();
+/// key the circuits with at most opts.jobs child processes; the library keeps a
+/// single global circuit, so parallel circuits need separate processes
+static bool GenerateBatch(const Options &opts) {
+    bool ok = true;
+    size_t next = 0, running = 0;
+    while (next < opts.circuits.size() || running > 0) {
+        if (next < opts.circuits.size() && running < opts.jobs) {
+            const string &circuit = opts.circuits[next++];
+            cout.flush();
+            const pid_t pid = fork();
+            if (pid == 0) {
+                const bool res = GenerateKeypair(opts, circuit);
+                cout.flush();
+                _exit(res ? 0 : 1);
+            }
+            if (pid < 0) {
+                cout << "fork for " << circuit << " fail." << endl;
+                ok = false;
+                continue;
+            }
+            ++running;
+            continue;
+        }
+        int status = 0;
+        if (wait(&status) < 0)
+            break;
+        --running;
+        ok &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    cout << "peak memory of a single job " << peakMemoryMB(RUSAGE_CHILDREN) << " MB" << endl;
+    return ok;
+}
+
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:j:t:b:m:cks:o:h")) != -1) {
+        switch (opt) {
+        case 'p': opts.publicInputs = atoi(optarg); break;
+        case 'j': opts.jobs = max(1, atoi(optarg)); break;
+        case 't': opts.threads = atoi(optarg); break;
+        case 'b':
+            if (string(optarg) == "groth16") {
+                opts.proofSystem = PS_GROTH16;
+            } else if (string(optarg) != "ppzksnark") {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'm': opts.memoryLimit = max(1, atoi(optarg)); break;
+        case 'c': opts.checkpoint = true; break;
+        case 'k': opts.keepCheckpoint = true; break;
+        case 's': opts.store = optarg; break;
+        case 'o': opts.outDir = optarg; break;
+        default: usage(argv[0]); return opt != 'h';
+        }
+    }
+    for (int i = optind; i < argc; i++)
+        opts.circuits.emplace_back(argv[i]);
+    if (opts.circuits.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    opts.passphrase = getenv("CSNARK_CHECKPOINT_KEY");
+    if (opts.checkpoint && opts.proofSystem == PS_GROTH16) {
+        cout << "-c is not supported for groth16, keys are generated without checkpoints" << endl;
+        opts.checkpoint = false;
+    }
+    if (!opts.store)
+        opts.store = getenv("CSNARK_KEY_STORE");
+    if (opts.checkpoint && (!opts.passphrase || !*opts.passphrase)) {
+        cout << "-c needs the checkpoint passphrase in CSNARK_CHECKPOINT_KEY" << endl;
+        return 1;
+    }
+
+    const long long start = libff::get_nsec_time();
+    bool ok = true;
+    if (opts.jobs == 1 || opts.circuits.size() == 1) {
+        for (const string &circuit : opts.circuits)
+            ok &= GenerateKeypair(opts, circuit);
+    } else {
+        ok = GenerateBatch(opts);
+    }
+    cout << opts.circuits.size() << " circuits in " << (libff::get_nsec_time() - start) / 1000000 << " ms" << endl;
+    return !ok;
 }
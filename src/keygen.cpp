@@ -0,0 +1,254 @@
+/** @file
+ *****************************************************************************
+ Memory bounded r1cs_ppzksnark key generation.
+
+ See details in keygen.hpp .
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include <algorithm>
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+#include <libff/algebra/scalar_multiplication/multiexp.hpp>
+#include <libff/common/profiling.hpp>
+#include <libff/common/serialization.hpp>
+#include <libsnark/knowledge_commitment/kc_multiexp.hpp>
+#include <libsnark/reductions/r1cs_to_qap/r1cs_to_qap.hpp>
+
+#include <keygen.hpp>
+
+namespace libsnark
+{
+
+typedef default_r1cs_ppzksnark_pp ppT;
+typedef libff::G1<ppT> G1;
+typedef libff::G2<ppT> G2;
+
+/// threads of kc_batch_exp, as in r1cs_ppzksnark_generator
+static size_t expChunks()
+{
+#ifdef MULTICORE
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/// scalars exponentiated per batch so that the batch stays below memory_limit
+template<typename T>
+static size_t batchSize(size_t memory_limit)
+{
+    return std::max<size_t>(1, memory_limit / (sizeof(T) + sizeof(FieldT)));
+}
+
+/// free the memory of v
+template<typename T>
+static void release(std::vector<T> &v)
+{
+    std::vector<T>().swap(v);
+}
+
+static size_t countNonZero(const std::vector<FieldT> &v)
+{
+    size_t n = 0;
+    for (auto &x : v)
+        n += x.is_zero() ? 0 : 1;
+    return n;
+}
+
+/// out << kc_batch_exp(..., v, ...) without holding the whole vector: the
+/// sparse_vector layout is domain size, non-zero indices, then the values
+template<typename T1, typename T2>
+static void writeKCQuery(std::ostream &out,
+                         size_t window1, size_t window2,
+                         const libff::window_table<T1> &table1,
+                         const libff::window_table<T2> &table2,
+                         const FieldT &coeff1, const FieldT &coeff2,
+                         const std::vector<FieldT> &v, size_t memory_limit)
+{
+    const size_t nonZero = countNonZero(v);
+    out << v.size() << "\n" << nonZero << "\n";
+    for (size_t i = 0; i < v.size(); i++)
+        if (!v[i].is_zero())
+            out << i << "\n";
+    out << nonZero << "\n";
+
+    const size_t step = batchSize<knowledge_commitment<T1, T2> >(memory_limit);
+    for (size_t begin = 0; begin < v.size(); begin += step) {
+        const std::vector<FieldT> part(v.begin() + begin, v.begin() + std::min(v.size(), begin + step));
+        const knowledge_commitment_vector<T1, T2> kc = kc_batch_exp(FieldT::size_in_bits(), window1, window2,
+                                                                    table1, table2, coeff1, coeff2, part, expChunks());
+        for (auto &t : kc.values)
+            out << t << OUTPUT_NEWLINE;
+    }
+}
+
+/// out << batch_exp(..., v) without holding the whole vector
+static void writeG1Query(std::ostream &out, size_t window, const libff::window_table<G1> &table,
+                         const std::vector<FieldT> &v, size_t memory_limit)
+{
+    out << v.size() << "\n";
+    const size_t step = batchSize<G1>(memory_limit);
+    for (size_t begin = 0; begin < v.size(); begin += step) {
+        const std::vector<FieldT> part(v.begin() + begin, v.begin() + std::min(v.size(), begin + step));
+        std::vector<G1> values = libff::batch_exp(FieldT::size_in_bits(), window, table, part);
+#ifdef USE_MIXED_ADDITION
+        libff::batch_to_special<G1>(values);
+#endif
+        for (auto &t : values)
+            out << t << OUTPUT_NEWLINE;
+    }
+}
+
+/// a proving key section is complete in out
+static void sectionDone(keygen_state &state, std::ostream &out, const keygen_progress &progress)
+{
+    out.flush();
+    ++state.sections;
+    state.offset = out.tellp();
+    if (progress)
+        progress(state);
+}
+
+r1cs_ppzksnark_verification_key<ppT>
+r1cs_ppzksnark_generator_to_stream(r1cs_constraint_system<FieldT> &cs,
+                                   std::ostream &pk_out,
+                                   size_t memory_limit,
+                                   keygen_state *state,
+                                   const keygen_progress &progress)
+{
+    libff::enter_block("Call to r1cs_ppzksnark_generator_to_stream");
+    keygen_state local;
+    keygen_state &st = state ? *state : local;
+
+    /* make the B_query "lighter" if possible */
+    cs.swap_AB_if_beneficial();
+
+    /* draw the random values, or take them from the run being resumed */
+    if (st.sections == 0) {
+        st.num_constraints = cs.num_constraints();
+        st.num_inputs = cs.num_inputs();
+        st.num_variables = cs.num_variables();
+        st.t = FieldT::random_element();
+        st.alphaA = FieldT::random_element();
+        st.alphaB = FieldT::random_element();
+        st.alphaC = FieldT::random_element();
+        st.rA = FieldT::random_element();
+        st.rB = FieldT::random_element();
+        st.beta = FieldT::random_element();
+        st.gamma = FieldT::random_element();
+    }
+    const FieldT &alphaA = st.alphaA, &alphaB = st.alphaB, &alphaC = st.alphaC,
+                 &rA = st.rA, &rB = st.rB, &beta = st.beta, &gamma = st.gamma;
+    const FieldT rC = rA * rB;
+
+    qap_instance_evaluation<FieldT> qap = r1cs_to_qap_instance_map_with_evaluation(cs, st.t);
+    const size_t numInputs = qap.num_inputs();
+    const size_t numVariables = qap.num_variables();
+    const FieldT Zt = qap.Zt;
+    std::vector<FieldT> At = std::move(qap.At);
+    std::vector<FieldT> Bt = std::move(qap.Bt);
+    std::vector<FieldT> Ct = std::move(qap.Ct);
+    std::vector<FieldT> Ht = std::move(qap.Ht);
+    At.emplace_back(Zt);
+    Bt.emplace_back(Zt);
+    Ct.emplace_back(Zt);
+
+    // same-coefficient-check query, before the prefix of At is zeroed
+    std::vector<FieldT> Kt;
+    Kt.reserve(numVariables + 4);
+    for (size_t i = 0; i < numVariables + 1; ++i)
+        Kt.emplace_back(beta * (rA * At[i] + rB * Bt[i] + rC * Ct[i]));
+    Kt.emplace_back(beta * rA * Zt);
+    Kt.emplace_back(beta * rB * Zt);
+    Kt.emplace_back(beta * rC * Zt);
+
+    // the prefix of At goes to the IC coefficients of the verification key
+    std::vector<FieldT> IC_coefficients(At.begin(), At.begin() + numInputs + 1);
+    std::fill(At.begin(), At.begin() + numInputs + 1, FieldT::zero());
+
+    const size_t nonZeroB = countNonZero(Bt);
+    const size_t g1_exp_count = 2 * (countNonZero(At) + countNonZero(Ct)) + nonZeroB + countNonZero(Ht) + Kt.size();
+    const size_t g1_window = libff::get_exp_window_size<G1>(g1_exp_count);
+    const size_t g2_window = libff::get_exp_window_size<G2>(nonZeroB);
+    libff::window_table<G1> g1_table = libff::get_window_table(FieldT::size_in_bits(), g1_window, G1::one());
+    libff::window_table<G2> g2_table = libff::get_window_table(FieldT::size_in_bits(), g2_window, G2::one());
+
+    // proving key: operator<<(r1cs_ppzksnark_proving_key) order, sections
+    // already written by the resumed run are skipped
+    libff::enter_block("Compute the A-query", false);
+    if (st.sections <= 0) {
+        writeKCQuery<G1, G1>(pk_out, g1_window, g1_window, g1_table, g1_table, rA, rA * alphaA, At, memory_limit);
+        sectionDone(st, pk_out, progress);
+    }
+    release(At);
+    libff::leave_block("Compute the A-query", false);
+
+    libff::enter_block("Compute the B-query", false);
+    if (st.sections <= 1) {
+        writeKCQuery<G2, G1>(pk_out, g2_window, g1_window, g2_table, g1_table, rB, rB * alphaB, Bt, memory_limit);
+        sectionDone(st, pk_out, progress);
+    }
+    release(Bt);
+    release(g2_table);
+    libff::leave_block("Compute the B-query", false);
+
+    libff::enter_block("Compute the C-query", false);
+    if (st.sections <= 2) {
+        writeKCQuery<G1, G1>(pk_out, g1_window, g1_window, g1_table, g1_table, rC, rC * alphaC, Ct, memory_limit);
+        sectionDone(st, pk_out, progress);
+    }
+    release(Ct);
+    libff::leave_block("Compute the C-query", false);
+
+    libff::enter_block("Compute the H-query", false);
+    if (st.sections <= 3) {
+        writeG1Query(pk_out, g1_window, g1_table, Ht, memory_limit);
+        sectionDone(st, pk_out, progress);
+    }
+    release(Ht);
+    libff::leave_block("Compute the H-query", false);
+
+    libff::enter_block("Compute the K-query", false);
+    if (st.sections <= 4) {
+        writeG1Query(pk_out, g1_window, g1_table, Kt, memory_limit);
+        sectionDone(st, pk_out, progress);
+    }
+    release(Kt);
+    libff::leave_block("Compute the K-query", false);
+
+    if (st.sections <= 5) {
+        pk_out << cs;
+        sectionDone(st, pk_out, progress);
+    }
+
+    // verification key
+    libff::enter_block("Generate R1CS verification key");
+    const G2 alphaA_g2 = alphaA * G2::one();
+    const G1 alphaB_g1 = alphaB * G1::one();
+    const G2 alphaC_g2 = alphaC * G2::one();
+    const G2 gamma_g2 = gamma * G2::one();
+    const G1 gamma_beta_g1 = (gamma * beta) * G1::one();
+    const G2 gamma_beta_g2 = (gamma * beta) * G2::one();
+    const G2 rC_Z_g2 = (rC * Zt) * G2::one();
+
+    G1 encoded_IC_base = (rA * IC_coefficients[0]) * G1::one();
+    std::vector<FieldT> multiplied_IC_coefficients;
+    multiplied_IC_coefficients.reserve(numInputs);
+    for (size_t i = 1; i < numInputs + 1; ++i)
+        multiplied_IC_coefficients.emplace_back(rA * IC_coefficients[i]);
+    std::vector<G1> encoded_IC_values = libff::batch_exp(FieldT::size_in_bits(), g1_window, g1_table, multiplied_IC_coefficients);
+    accumulation_vector<G1> encoded_IC_query(std::move(encoded_IC_base), std::move(encoded_IC_values));
+    libff::leave_block("Generate R1CS verification key");
+
+    libff::leave_block("Call to r1cs_ppzksnark_generator_to_stream");
+    return r1cs_ppzksnark_verification_key<ppT>(alphaA_g2, alphaB_g1, alphaC_g2, gamma_g2,
+                                                gamma_beta_g1, gamma_beta_g2, rC_Z_g2, encoded_IC_query);
+}
+
+} // namespace libsnark
@@ -0,0 +1,69 @@
+/** @file
+ *****************************************************************************
+ Memory bounded r1cs_ppzksnark key generation.
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef LIBCSNARK_KEYGEN_HPP_
+#define LIBCSNARK_KEYGEN_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#include <libff/algebra/fields/field_utils.hpp>
+#include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
+#include <libsnark/relations/constraint_satisfaction_problems/r1cs/r1cs.hpp>
+#include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
+
+namespace libsnark
+{
+
+typedef libff::Fr<libff::default_ec_pp> FieldT;
+
+/// toxic waste and progress of r1cs_ppzksnark_generator_to_stream, enough to
+/// resume an interrupted run (see checkpoint.hpp)
+struct keygen_state {
+    size_t num_constraints = 0;
+    size_t num_inputs = 0;
+    size_t num_variables = 0;
+    size_t sections = 0;        // proving key sections (A, B, C, H, K, cs) in the stream
+    uint64_t offset = 0;        // stream position after them
+    std::string fingerprint;    // r1cs_fingerprint of the cs being keyed, set by the caller
+    FieldT t, alphaA, alphaB, alphaC, rA, rB, beta, gamma;
+};
+
+/// called after each proving key section, the stream is flushed
+typedef std::function<void(const keygen_state&)> keygen_progress;
+
+/// number of sections of a proving key
+const size_t KEYGEN_SECTIONS = 6;
+
+/// r1cs_ppzksnark_generator that writes the proving key while it computes it.
+///
+/// The generator keeps every query of the proving key in memory and the key
+/// is then serialized once more into a string. Here only the QAP evaluations
+/// (field elements) live for the whole run: the A, B, C, H and K queries are
+/// exponentiated at most memory_limit bytes of group elements at a time,
+/// appended to pk_out and released, followed by the constraint system. The
+/// bytes match operator<< of r1cs_ppzksnark_proving_key, so the key is read
+/// back by Deserial_pkey as before. cs is the one stored in the key and may
+/// get A and B swapped (swap_AB_if_beneficial).
+///
+/// With a state that already has sections written, its random values are
+/// reused and those sections are skipped: pk_out must then be positioned at
+/// state->offset of the key being resumed. Otherwise the values are sampled
+/// into state. progress is called after every section.
+r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp>
+r1cs_ppzksnark_generator_to_stream(r1cs_constraint_system<FieldT> &cs,
+                                   std::ostream &pk_out,
+                                   size_t memory_limit,
+                                   keygen_state *state = nullptr,
+                                   const keygen_progress &progress = keygen_progress());
+
+} // namespace libsnark
+
+#endif // LIBCSNARK_KEYGEN_HPP_
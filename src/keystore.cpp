@@ -0,0 +1,165 @@
+/** @file
+ *****************************************************************************
+ R1CS fingerprint and a content addressed store of generated key pairs.
+
+ See details in keystore.hpp .
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <typeinfo>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+
+#include <keystore.hpp>
+
+namespace libsnark
+{
+
+typedef linear_combination<FieldT> LC;
+
+/// incremental SHA-256
+class Sha256 {
+public:
+    Sha256() : ctx_(EVP_MD_CTX_create()) { EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr); }
+    ~Sha256() { EVP_MD_CTX_destroy(ctx_); }
+
+    void update(const void *data, size_t size) { EVP_DigestUpdate(ctx_, data, size); }
+    void update(uint64_t x) { update(&x, sizeof(x)); }
+
+    std::string hex()
+    {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int size = 0;
+        EVP_DigestFinal_ex(ctx_, digest, &size);
+        static const char digits[] = "0123456789abcdef";
+        std::string result;
+        for (unsigned int i = 0; i < size; i++) {
+            result += digits[digest[i] >> 4];
+            result += digits[digest[i] & 15];
+        }
+        return result;
+    }
+
+private:
+    EVP_MD_CTX *ctx_;
+};
+
+/// terms sorted by index, duplicates merged, zeros dropped
+static void hashLC(Sha256 &sha, const LC &lc)
+{
+    std::vector<linear_term<FieldT> > terms(lc.terms);
+    std::stable_sort(terms.begin(), terms.end(),
+                     [](const linear_term<FieldT> &x, const linear_term<FieldT> &y) { return x.index < y.index; });
+    std::vector<linear_term<FieldT> > merged;
+    for (auto &t : terms) {
+        if (!merged.empty() && merged.back().index == t.index)
+            merged.back().coeff += t.coeff;
+        else
+            merged.emplace_back(t);
+    }
+
+    size_t count = 0;
+    for (auto &t : merged)
+        count += t.coeff.is_zero() ? 0 : 1;
+    sha.update(count);
+    for (auto &t : merged) {
+        if (t.coeff.is_zero())
+            continue;
+        const auto coeff = t.coeff.as_bigint();
+        sha.update(t.index);
+        sha.update(coeff.data, sizeof(coeff.data));
+    }
+}
+
+std::string r1cs_fingerprint(const r1cs_constraint_system<FieldT> &cs,
+                             const std::vector<size_t> &removedVars,
+                             const std::string &proofSystem)
+{
+    Sha256 sha;
+    const std::string tag = std::string("csnark-r1cs-2 ") + typeid(libff::default_ec_pp).name();
+    sha.update(tag.data(), tag.size() + 1);
+    sha.update(proofSystem.data(), proofSystem.size() + 1);
+    sha.update(cs.primary_input_size);
+    sha.update(cs.auxiliary_input_size);
+    sha.update(cs.constraints.size());
+    for (auto &c : cs.constraints) {
+        hashLC(sha, c.a);
+        hashLC(sha, c.b);
+        hashLC(sha, c.c);
+    }
+    sha.update(removedVars.size());
+    for (size_t index : removedVars)
+        sha.update(index);
+    return sha.hex();
+}
+
+/// dest := src through a temporary file. A copy, not a hard link: keygen
+/// truncates and rewrites its output files in place
+static bool install(const std::string &src, const std::string &dest)
+{
+    const std::string tmp = dest + ".tmp" + std::to_string(getpid());
+    bool ok;
+    {
+        std::ifstream in(src, std::ios::binary);
+        std::ofstream out(tmp, std::ios::binary);
+        ok = in && out && (out << in.rdbuf()) && out.flush();
+    }
+    ok = ok && rename(tmp.c_str(), dest.c_str()) == 0;
+    if (!ok)
+        unlink(tmp.c_str());
+    return ok;
+}
+
+key_store::key_store(const std::string &dir) : dir_(dir)
+{
+    mkdir(dir_.c_str(), 0700);
+}
+
+std::string key_store::path(const std::string &fingerprint, const char *file) const
+{
+    return dir_ + "/" + fingerprint + "/" + file;
+}
+
+bool key_store::contains(const std::string &fingerprint) const
+{
+    return access(path(fingerprint, "pk").c_str(), R_OK) == 0
+        && access(path(fingerprint, "vk").c_str(), R_OK) == 0;
+}
+
+bool key_store::fetch(const std::string &fingerprint, const std::string &pkPath, const std::string &vkPath) const
+{
+    // a published directory never changes, the two copies are of one pair
+    return contains(fingerprint)
+        && install(path(fingerprint, "pk"), pkPath)
+        && install(path(fingerprint, "vk"), vkPath);
+}
+
+bool key_store::store(const std::string &fingerprint, const std::string &pkPath, const std::string &vkPath) const
+{
+    if (contains(fingerprint))
+        return true;
+
+    // fill <fingerprint>.tmp<pid>/ and publish it with a single rename, which
+    // fails if another run renamed its directory there first
+    const std::string tmp = dir_ + "/" + fingerprint + ".tmp" + std::to_string(getpid());
+    const std::string tmpPk = tmp + "/pk", tmpVk = tmp + "/vk";
+    bool ok = mkdir(tmp.c_str(), 0700) == 0
+           && install(pkPath, tmpPk)
+           && install(vkPath, tmpVk);
+    if (ok && rename(tmp.c_str(), (dir_ + "/" + fingerprint).c_str()) == 0)
+        return true;
+    unlink(tmpPk.c_str());
+    unlink(tmpVk.c_str());
+    rmdir(tmp.c_str());
+    return ok && contains(fingerprint);
+}
+
+} // namespace libsnark
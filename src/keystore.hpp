@@ -0,0 +1,61 @@
+/** @file
+ *****************************************************************************
+ R1CS fingerprint and a content addressed store of generated key pairs.
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef LIBCSNARK_KEYSTORE_HPP_
+#define LIBCSNARK_KEYSTORE_HPP_
+
+#include <string>
+#include <vector>
+
+#include <libff/algebra/fields/field_utils.hpp>
+#include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
+#include <libsnark/relations/constraint_satisfaction_problems/r1cs/r1cs.hpp>
+
+namespace libsnark
+{
+
+typedef libff::Fr<libff::default_ec_pp> FieldT;
+
+/// SHA-256 (64 hex digits) of a canonical encoding of cs: the curve, the
+/// proof system the keys are for (its key tag, e.g. "r1cs_gg_ppzksnark"), the
+/// input sizes, and every constraint in order with the terms of each linear
+/// combination sorted by index, duplicates merged and zeros dropped. The
+/// variables removed by the linear elimination are hashed too since they
+/// are part of the proving key. Equal circuits get equal fingerprints
+/// whatever the term order their gadgets produced.
+std::string r1cs_fingerprint(const r1cs_constraint_system<FieldT> &cs,
+                             const std::vector<size_t> &removedVars,
+                             const std::string &proofSystem);
+
+/// Directory of key pairs named by fingerprint: <dir>/<fingerprint>/pk and vk.
+/// A pair is written to a temporary directory that is renamed to
+/// <fingerprint> in one step, and a published pair is never replaced: a
+/// concurrent keygen run sees either no pair or a complete, matching one.
+class key_store {
+public:
+    explicit key_store(const std::string &dir);
+
+    bool contains(const std::string &fingerprint) const;
+
+    /// copy the stored keys of fingerprint to pkPath and vkPath
+    bool fetch(const std::string &fingerprint, const std::string &pkPath, const std::string &vkPath) const;
+
+    /// add the key files pkPath and vkPath under fingerprint. If another run
+    /// published a pair for fingerprint first, that pair stays and this one
+    /// is dropped (true: the store has keys for fingerprint).
+    bool store(const std::string &fingerprint, const std::string &pkPath, const std::string &vkPath) const;
+
+private:
+    std::string path(const std::string &fingerprint, const char *file) const;
+
+    const std::string dir_;
+};
+
+} // namespace libsnark
+
+#endif // LIBCSNARK_KEYSTORE_HPP_
@@ -0,0 +1,251 @@
+/** @file
+ *****************************************************************************
+ Constraint system passes run on the exported R1CS before key generation.
+
+ See details in optimizer.hpp .
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include <algorithm>
+#include <deque>
+
+#include <optimizer.hpp>
+
+namespace libsnark
+{
+
+typedef linear_combination<FieldT> LC;
+
+/// sort the terms by index, merge duplicated indexes and drop zero coefficients
+static void normalize(LC &lc)
+{
+    std::stable_sort(lc.terms.begin(), lc.terms.end(),
+                     [](const linear_term<FieldT> &x, const linear_term<FieldT> &y) { return x.index < y.index; });
+    std::vector<linear_term<FieldT> > terms;
+    terms.reserve(lc.terms.size());
+    for (auto &t : lc.terms) {
+        if (!terms.empty() && terms.back().index == t.index)
+            terms.back().coeff += t.coeff;
+        else
+            terms.emplace_back(t);
+    }
+    lc.terms.clear();
+    for (auto &t : terms)
+        if (!t.coeff.is_zero())
+            lc.terms.emplace_back(t);
+}
+
+/// value of lc if it only holds the constant term
+static bool isConstant(const LC &lc, FieldT &k)
+{
+    k = FieldT::zero();
+    for (auto &t : lc.terms) {
+        if (t.index != 0)
+            return false;
+        k += t.coeff;
+    }
+    return true;
+}
+
+/// number of occurrences of var in the linear combinations of a constraint
+static size_t countUses(const r1cs_constraint<FieldT> &c, size_t var)
+{
+    size_t uses = 0;
+    for (const LC *lc : {&c.a, &c.b, &c.c})
+        for (auto &t : lc->terms)
+            if (t.index == var) {
+                ++uses;
+                break;
+            }
+    return uses;
+}
+
+/// lc := lc[var := def]
+static void substitute(LC &lc, size_t var, const LC &def)
+{
+    FieldT alpha = FieldT::zero();
+    bool found = false;
+    std::vector<linear_term<FieldT> > terms;
+    for (auto &t : lc.terms) {
+        if (t.index == var) {
+            alpha += t.coeff;
+            found = true;
+        } else {
+            terms.emplace_back(t);
+        }
+    }
+    if (!found)
+        return;
+    lc.terms.swap(terms);
+    for (auto &t : def.terms)
+        lc.terms.emplace_back(t.index, alpha * t.coeff);
+    normalize(lc);
+}
+
+/// L with L = 0 if the constraint is linear
+static bool linearForm(const r1cs_constraint<FieldT> &c, LC &L)
+{
+    FieldT k;
+    const LC *other = nullptr;
+    if (isConstant(c.a, k))
+        other = &c.b;
+    else if (isConstant(c.b, k))
+        other = &c.a;
+    else
+        return false;
+
+    L.terms.clear();
+    for (auto &t : other->terms)
+        L.terms.emplace_back(t.index, k * t.coeff);
+    for (auto &t : c.c.terms)
+        L.terms.emplace_back(t.index, -t.coeff);
+    normalize(L);
+    return true;
+}
+
+size_t r1cs_eliminate_linear(r1cs_constraint_system<FieldT> &cs,
+                             std::vector<size_t> &removedVars)
+{
+    const size_t numInputs = cs.num_inputs();
+    const size_t numVars = cs.num_variables();
+    std::vector<r1cs_constraint<FieldT> > &constraints = cs.constraints;
+
+    // var -> constraints using it (may hold duplicates and stale entries)
+    std::vector<std::vector<size_t> > occ(numVars + 1);
+    for (size_t i = 0; i < constraints.size(); i++)
+        for (const LC *lc : {&constraints[i].a, &constraints[i].b, &constraints[i].c})
+            for (auto &t : lc->terms)
+                if (t.index != 0)
+                    occ[t.index].emplace_back(i);
+
+    std::vector<bool> dropped(constraints.size(), false);
+    std::deque<size_t> worklist;
+    for (size_t i = 0; i < constraints.size(); i++)
+        worklist.emplace_back(i);
+
+    size_t numEliminated = 0;
+    LC L;
+    while (!worklist.empty()) {
+        size_t row = worklist.front();
+        worklist.pop_front();
+        if (dropped[row] || !linearForm(constraints[row], L))
+            continue;
+
+        if (L.terms.empty()) {
+            // 0 = 0, no information
+            dropped[row] = true;
+            continue;
+        }
+
+        // pick the auxiliary variable of L with the fewest uses
+        size_t var = 0, uses = 0;
+        FieldT coeff;
+        for (auto &t : L.terms) {
+            if (t.index <= numInputs)
+                continue;
+            std::vector<size_t> &rows = occ[t.index];
+            std::sort(rows.begin(), rows.end());
+            rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+            size_t n = 0;
+            for (size_t k : rows)
+                if (k != row && !dropped[k])
+                    n += countUses(constraints[k], t.index);
+            if (var == 0 || n < uses) {
+                var = t.index;
+                uses = n;
+                coeff = t.coeff;
+            }
+        }
+        if (var == 0)
+            continue;
+
+        // var = -(L - coeff * var) / coeff
+        LC def;
+        const FieldT scale = -coeff.inverse();
+        for (auto &t : L.terms)
+            if (t.index != var)
+                def.terms.emplace_back(t.index, scale * t.coeff);
+
+        const size_t defTerms = def.terms.size();
+        if (defTerms > 0 && (defTerms - 1) * uses > defTerms + uses)
+            continue;
+
+        std::vector<size_t> users;
+        users.swap(occ[var]);
+        for (size_t k : users) {
+            if (k == row || dropped[k] || countUses(constraints[k], var) == 0)
+                continue;
+            substitute(constraints[k].a, var, def);
+            substitute(constraints[k].b, var, def);
+            substitute(constraints[k].c, var, def);
+            for (auto &t : def.terms)
+                if (t.index != 0)
+                    occ[t.index].emplace_back(k);
+            // substitution may have turned A or B into a constant
+            worklist.emplace_back(k);
+        }
+        dropped[row] = true;
+        ++numEliminated;
+    }
+
+    std::vector<r1cs_constraint<FieldT> > kept;
+    for (size_t i = 0; i < constraints.size(); i++)
+        if (!dropped[i])
+            kept.emplace_back(constraints[i]);
+    constraints.swap(kept);
+
+    r1cs_remove_unused(cs, removedVars);
+    return numEliminated;
+}
+
+void r1cs_remove_unused(r1cs_constraint_system<FieldT> &cs,
+                        std::vector<size_t> &removedVars)
+{
+    const size_t numInputs = cs.num_inputs();
+    const size_t numVars = cs.num_variables();
+    std::vector<r1cs_constraint<FieldT> > &constraints = cs.constraints;
+
+    std::vector<bool> used(numVars + 1, false);
+    for (size_t i = 0; i <= numInputs; i++)
+        used[i] = true;
+    for (auto &c : constraints)
+        for (const LC *lc : {&c.a, &c.b, &c.c})
+            for (auto &t : lc->terms)
+                used[t.index] = true;
+
+    std::vector<size_t> newIndex(numVars + 1, 0);
+    size_t next = 0;
+    removedVars.clear();
+    for (size_t i = 0; i <= numVars; i++) {
+        if (used[i])
+            newIndex[i] = next++;
+        else
+            removedVars.emplace_back(i);
+    }
+
+    for (auto &c : constraints)
+        for (LC *lc : {&c.a, &c.b, &c.c})
+            for (auto &t : lc->terms)
+                t.index = newIndex[t.index];
+    cs.auxiliary_input_size = next - 1 - numInputs;
+}
+
+r1cs_variable_assignment<FieldT> r1cs_project_assignment(const r1cs_variable_assignment<FieldT> &full,
+                                                         const std::vector<size_t> &removedVars)
+{
+    r1cs_variable_assignment<FieldT> result;
+    result.reserve(full.size() - removedVars.size());
+    size_t r = 0;
+    for (size_t i = 1; i <= full.size(); i++) {
+        if (r < removedVars.size() && removedVars[r] == i) {
+            ++r;
+            continue;
+        }
+        result.emplace_back(full[i - 1]);
+    }
+    return result;
+}
+
+} // namespace libsnark
@@ -0,0 +1,50 @@
+/** @file
+ *****************************************************************************
+ Constraint system passes run on the exported R1CS before key generation.
+ *****************************************************************************
+ * @author     chegvra.
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef LIBCSNARK_OPTIMIZER_HPP_
+#define LIBCSNARK_OPTIMIZER_HPP_
+
+#include <vector>
+
+#include <libff/algebra/fields/field_utils.hpp>
+#include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
+#include <libsnark/relations/constraint_satisfaction_problems/r1cs/r1cs.hpp>
+
+namespace libsnark
+{
+
+typedef libff::Fr<libff::default_ec_pp> FieldT;
+
+/// Linear constraint elimination.
+///
+/// A constraint whose A or B side is a constant is a linear relation
+/// L(x) = 0. One auxiliary variable x_j of L is chosen (fewest uses), its
+/// definition x_j = -(L - c_j*x_j)/c_j is substituted into every other
+/// constraint and the defining constraint is dropped. The substitution is
+/// only done while (defTerms - 1) * uses <= defTerms + uses, counted per
+/// linear combination, so dense definitions such as bit packing are kept.
+///
+/// Afterwards the system is compacted by r1cs_remove_unused. Primary inputs
+/// are never touched. Returns the number of constraints eliminated.
+size_t r1cs_eliminate_linear(r1cs_constraint_system<FieldT> &cs,
+                             std::vector<size_t> &removedVars);
+
+/// Drop every auxiliary variable no longer referenced by a constraint and
+/// renumber the remaining ones in order. removedVars receives the (1-based)
+/// indices of the dropped variables in ascending order; pass it to
+/// r1cs_project_assignment to get a matching witness.
+void r1cs_remove_unused(r1cs_constraint_system<FieldT> &cs,
+                        std::vector<size_t> &removedVars);
+
+/// drop the variables listed by r1cs_eliminate_linear from a full assignment
+r1cs_variable_assignment<FieldT> r1cs_project_assignment(const r1cs_variable_assignment<FieldT> &full,
+                                                         const std::vector<size_t> &removedVars);
+
+} // namespace libsnark
+
+#endif // LIBCSNARK_OPTIMIZER_HPP_
@@ -7,6 +7,8 @@
  * @copyright  MIT license (see LICENSE file)
  *****************************************************************************/
 
+#include <climits>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 
@@ -24,6 +26,10 @@
 #include <libff/common/profiling.hpp>
 
 #include "gadget2.hpp"
+#include "optimizer.hpp"
+#include "checkpoint.hpp"
+#include "keystore.hpp"
+#include "goLayer.h"
 
 
 using ::std::cerr;
@@ -34,6 +40,18 @@ using namespace gadgetlib2;
 using namespace libsnark;
 
 typedef libff::Fr<libff::default_ec_pp> FieldT;
+
+/// libcsnark function decl
+extern "C" ProtoboardPtr g_pbp;
+extern "C" ::std::vector<size_t> g_vectRemovedVars;
+extern "C" ::std::vector<GadgetPtr> g_vectGadgets;
+extern "C" Witness_Func g_pfnWitness;
+extern "C" void ExportConstraintSystem(unsigned primary_input_size, r1cs_constraint_system<FieldT> &cs);
+extern "C" r1cs_variable_assignment<FieldT> GetVariableAssignment();
+extern "C" void GetProverInput(size_t NumInputs, r1cs_primary_input<FieldT> &Primary, r1cs_auxiliary_input<FieldT> &Auxiliary);
+extern "C" bool keypairGenToFile(r1cs_constraint_system<FieldT> &cs, const char *pPKPath, std::string &vkey, size_t memoryLimit,
+                                 const char *pCheckpoint, const char *pPassphrase, bool bKeepCheckpoint, int32 ProofSystem);
+extern "C" void keypairGen(unsigned primary_input_size, std::string &pkey, std::string &vkey, int32 ProofSystem);
 int prove_test(ProtoboardPtr pb, size_t input_size)
 {
     libff::enter_block("Call to prove_test");
@@ -517,6 +535,1361 @@ void unit_test_gegadget(int64_t a, int64_t b, int res)
     libff::leave_block("leave  test_gegadget");
 }
 
+void test_mulconstgadget()
+{
+    libff::enter_block("Call to test_mulconstgadget");
+    gadgetlib2::initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = Protoboard::create(R1P);
+    Variable A("A");
+    Variable result("result");
+
+    auto mulGadget = MULConst_Gadget::create(pb, A, 7, result);
+    mulGadget->generateConstraints();
+
+    pb->val(A) = 6;
+    mulGadget->generateWitness();
+    prove_test(pb, 2);
+
+    EXPECT_EQ(pb->val(result), 42);
+    pb->val(result) = 41;
+    EXPECT_FALSE(pb->isSatisfied());
+    libff::leave_block("leave  test_mulconstgadget");
+}
+
+void unit_test_udivconstgadget(unsigned long a, unsigned long c, long q, long r)
+{
+    libff::enter_block("Call to test_udivconstgadget");
+    gadgetlib2::initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = Protoboard::create(R1P);
+    Variable A("A");
+    Variable Q("Q");
+    Variable R("R");
+
+    auto divGadget = UDivisionConst_Gadget::create(pb, A, c, Q, R);
+    divGadget->generateConstraints();
+
+    pb->val(A) = (long)a;
+    divGadget->generateWitness();
+    prove_test(pb, 3);
+
+    EXPECT_EQ(pb->val(Q), q);
+    EXPECT_EQ(pb->val(R), r);
+    pb->val(R) = r + c;
+    pb->val(Q) = q - 1;
+    EXPECT_FALSE(pb->isSatisfied());
+    libff::leave_block("leave  test_udivconstgadget");
+}
+
+void test_udivconstgadget() {
+    unit_test_udivconstgadget(100, 1, 100, 0);
+    unit_test_udivconstgadget(100, 8, 12, 4);
+    unit_test_udivconstgadget(0x81002011, 0x10000, 0x8100, 0x2011);
+    unit_test_udivconstgadget(100, 7, 14, 2);
+    unit_test_udivconstgadget(4999, 5000, 0, 4999);
+    unit_test_udivconstgadget(0x7FFFFFFFFFFFFFFF, 3, 0x2AAAAAAAAAAAAAAA, 1);
+}
+
+void unit_test_cmpconstgadget(long a, long c, bool isSigned, bool orEqual, bool constIsLhs, int res)
+{
+    libff::enter_block("Call to test_cmpconstgadget");
+    gadgetlib2::initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = Protoboard::create(R1P);
+    Variable A("A");
+    Variable result("result");
+
+    auto cmpGadget = CMPConst_Gadget::create(pb, A, c, isSigned, orEqual, constIsLhs, result);
+    cmpGadget->generateConstraints();
+
+    pb->val(A) = a;
+    cmpGadget->generateWitness();
+    prove_test(pb, 2);
+
+    EXPECT_EQ(pb->val(result), res);
+    pb->val(result) = 1 - res;
+    EXPECT_FALSE(pb->isSatisfied());
+    libff::leave_block("leave  test_cmpconstgadget");
+}
+
+void unit_test_eqconstgadget(long a, long c, bool isNeq, int res)
+{
+    libff::enter_block("Call to test_eqconstgadget");
+    gadgetlib2::initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = Protoboard::create(R1P);
+    Variable A("A");
+    Variable result("result");
+
+    auto eqGadget = EQConst_Gadget::create(pb, A, c, isNeq, result);
+    eqGadget->generateConstraints();
+
+    pb->val(A) = a;
+    eqGadget->generateWitness();
+    prove_test(pb, 2);
+
+    EXPECT_EQ(pb->val(result), res);
+    pb->val(result) = 1 - res;
+    EXPECT_FALSE(pb->isSatisfied());
+    libff::leave_block("leave  test_eqconstgadget");
+}
+
+void test_cmpconstgadget() {
+    unit_test_cmpconstgadget(4999, 5000, false, false, false, 0);
+    unit_test_cmpconstgadget(5000, 5000, false, false, false, 0);
+    unit_test_cmpconstgadget(5001, 5000, false, false, false, 1);
+    unit_test_cmpconstgadget(5000, 5000, false, true, false, 1);
+    unit_test_cmpconstgadget(4999, 5000, false, false, true, 1);
+    unit_test_cmpconstgadget(5000, 5000, false, true, true, 1);
+    unit_test_cmpconstgadget(0x81002011, 5000, false, false, true, 0);
+    unit_test_cmpconstgadget(1, 0, false, false, false, 1);
+    unit_test_cmpconstgadget(0, 0, false, true, true, 1);
+    unit_test_cmpconstgadget(4999, 5000, true, false, true, 1);
+    unit_test_cmpconstgadget(5000, 5000, true, false, true, 0);
+    unit_test_cmpconstgadget(4999, 5000, true, false, false, 0);
+    unit_test_cmpconstgadget(5001, 5000, true, false, false, 1);
+    unit_test_cmpconstgadget(-1, 5000, true, false, true, 1);
+    unit_test_cmpconstgadget(-1, 5000, true, true, false, 0);
+    unit_test_cmpconstgadget(LONG_MIN, 0, true, false, false, 0);
+    unit_test_cmpconstgadget(LONG_MAX, 0, true, false, false, 1);
+    unit_test_cmpconstgadget(-4999, -5000, true, false, false, 1);
+    unit_test_cmpconstgadget(-5001, -5000, true, false, false, 0);
+    unit_test_cmpconstgadget(-5000, -5000, true, true, false, 1);
+    unit_test_cmpconstgadget(5000, -5000, true, false, false, 1);
+    unit_test_cmpconstgadget(-5001, -5000, true, false, true, 1);
+    unit_test_cmpconstgadget(LONG_MIN, -1, true, false, true, 1);
+    unit_test_cmpconstgadget(-1, LONG_MIN, true, false, false, 1);
+    unit_test_cmpconstgadget(LONG_MIN, LONG_MIN, true, true, true, 1);
+}
+
+void test_eqconstgadget() {
+    unit_test_eqconstgadget(0, 0, false, 1);
+    unit_test_eqconstgadget(5000, 5000, false, 1);
+    unit_test_eqconstgadget(4999, 5000, false, 0);
+    unit_test_eqconstgadget(5000, 5000, true, 0);
+    unit_test_eqconstgadget(0x81002011, 5000, true, 1);
+}
+
+/// mod == 0 is the wrapping power of G_POW. The operands are set as unsigned
+/// words, or as negative field elements when asSigned (rejected by the gadget).
+void unit_test_powmodgadget(unsigned long base, unsigned long e, unsigned long mod,
+                            bool isExpConst, bool isModConst, unsigned long res, bool asSigned = false)
+{
+    libff::enter_block("Call to test_powmodgadget");
+    gadgetlib2::initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = Protoboard::create(R1P);
+    Variable B("B");
+    Variable E("E");
+    Variable M("M");
+    Variable result("result");
+
+    auto powGadget = POWMOD_Gadget::create(pb, B, E, M, result, isExpConst, e, isModConst, mod);
+    powGadget->generateConstraints();
+
+    auto word = [asSigned](unsigned long x) {
+        return asSigned ? FElem((long)x) : FlatElem(x).asFElem();
+    };
+    pb->val(B) = word(base);
+    pb->val(E) = word(e);
+    pb->val(M) = word(mod);
+    if (asSigned) {
+        EXPECT_THROW(powGadget->generateWitness(), ::std::runtime_error);
+        libff::leave_block("leave  test_powmodgadget");
+        return;
+    }
+    powGadget->generateWitness();
+    cout << base << " ^ " << e << " mod " << mod << ", number of constraints: "
+         << pb->constraintSystem().getNumberOfConstraints() << endl;
+    prove_test(pb, 4);
+
+    EXPECT_EQ((unsigned long)pb->val(result).asLong(), res);
+    pb->val(result) = (long)(res + 1);
+    EXPECT_FALSE(pb->isSatisfied());
+    libff::leave_block("leave  test_powmodgadget");
+}
+
+void test_powmodgadget() {
+    unit_test_powmodgadget(3, 5, 7, true, true, 5);
+    unit_test_powmodgadget(3, 5, 7, false, false, 5);
+    unit_test_powmodgadget(3, 5, 7, true, false, 5);
+    unit_test_powmodgadget(3, 5, 7, false, true, 5);
+    unit_test_powmodgadget(7, 0, 1, true, true, 0);
+    unit_test_powmodgadget(7, 0, 1, false, false, 0);
+    unit_test_powmodgadget(12345, 1, 100, true, true, 45);
+    unit_test_powmodgadget(2, 64, 0, true, true, 0);
+    unit_test_powmodgadget(9, 5000, 0, true, true, 781293612478825281UL);
+    unit_test_powmodgadget(12345, 8000, 0, false, true, 6052791302267661825UL);
+    unit_test_powmodgadget(0x7edcba9876543210UL, 0x10001, 0xffffffffffffffc5UL, true, true, 691600205901248552UL);
+    unit_test_powmodgadget(0x7edcba9876543210UL, 0x10001, 0x7fffffffffffffe7UL, false, false, 7562501974472037771UL);
+    // a variable modulus of 0 is 2^64 as well
+    unit_test_powmodgadget(2, 64, 0, true, false, 0);
+    unit_test_powmodgadget(9, 5000, 0, false, false, 781293612478825281UL);
+    unit_test_powmodgadget(0xfedcba9876543210UL, 3, 0, true, false, 10652602892710973440UL);
+    // operands of 2^63 and above
+    unit_test_powmodgadget(0xfedcba9876543210UL, 0x10001, 0xffffffffffffffc5UL, true, true, 17443294879677306931UL);
+    unit_test_powmodgadget(0xfedcba9876543210UL, 0x10001, 0xffffffffffffffc5UL, false, false, 17443294879677306931UL);
+    unit_test_powmodgadget(0xfedcba9876543210UL, 0xfffffffffffffff1UL, 0x8000000000000001UL, false, false, 8445106028135168892UL);
+    // the same words as negative field elements
+    unit_test_powmodgadget(0xfedcba9876543210UL, 0x10001, 0xffffffffffffffc5UL, false, false, 0, true);
+}
+
+/// constraint count of n loop guards `i < bound` of the pow workload,
+/// through the general signed comparator or its constant specialization
+size_t loop_guard_test(size_t n, long bound, bool useConst)
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+    Variable one("one");
+    Variable bnd("bound");
+    VariableArray iter(n + 1, "i");
+    VariableArray guard(n, "guard");
+
+    auto pb = Protoboard::create(R1P);
+    ::std::vector<GadgetPtr> computeResult;
+
+    for (size_t i = 0; i < n; i++) {
+        if (useConst)
+            computeResult.push_back(CMPConst_Gadget::create(pb, iter[i], bound, true, false, true, guard[i]));
+        else
+            computeResult.push_back(SGT_Gadget::create(pb, bnd, iter[i], guard[i]));
+        computeResult.push_back(ADD_Gadget::create(pb, iter[i], one, iter[i+1]));
+    }
+
+    libff::enter_block("Call to generateConstraints");
+    for (auto& curGadget : computeResult)
+        curGadget->generateConstraints();
+    libff::leave_block("Call to generateConstraints");
+
+    libff::enter_block("Call to generateWitness");
+    pb->val(one) = 1;
+    pb->val(bnd) = bound;
+    pb->val(iter[0]) = 0;
+    for (auto& curGadget : computeResult)
+        curGadget->generateWitness();
+    libff::leave_block("Call to generateWitness");
+
+    EXPECT_TRUE(pb->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    size_t num = pb->constraintSystem().getNumberOfConstraints();
+    cout << (useConst ? "const" : "general") << " loop guard, " << n
+         << " iterations, number of constraints: " << num << endl;
+    return num;
+}
+
+void test_linear_elim(size_t n)
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+    Variable one("one");
+    VariableArray iter(n + 1, "i");
+    VariableArray acc(n + 1, "acc");
+    VariableArray tmp(n, "tmp");
+    VariableArray low(n, "low");
+
+    auto pb = Protoboard::create(R1P);
+    ::std::vector<GadgetPtr> computeResult;
+
+    for (size_t i = 0; i < n; i++) {
+        computeResult.push_back(ADD_Gadget::create(pb, iter[i], one, iter[i+1]));
+        computeResult.push_back(SUB_Gadget::create(pb, acc[i], iter[i], tmp[i]));
+        computeResult.push_back(TRUNC_Gadget::create(pb, tmp[i], 32, 8, low[i]));
+        computeResult.push_back(MULConst_Gadget::create(pb, low[i], 3, acc[i+1]));
+    }
+    for (auto& curGadget : computeResult)
+        curGadget->generateConstraints();
+
+    pb->val(one) = 1;
+    pb->val(iter[0]) = 0;
+    pb->val(acc[0]) = 1000;
+    for (auto& curGadget : computeResult)
+        curGadget->generateWitness();
+    EXPECT_TRUE(pb->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+
+    r1cs_constraint_system<FieldT> cs = get_constraint_system_from_gadgetlib2(*pb);
+    cs.primary_input_size = 2;
+    cs.auxiliary_input_size -= cs.primary_input_size;
+    const size_t numConstraints = cs.num_constraints();
+    const r1cs_variable_assignment<FieldT> full_assignment = get_variable_assignment_from_gadgetlib2(*pb);
+
+    ::std::vector<size_t> removedVars;
+    const size_t eliminated = r1cs_eliminate_linear(cs, removedVars);
+    const r1cs_variable_assignment<FieldT> assignment = r1cs_project_assignment(full_assignment, removedVars);
+    const r1cs_primary_input<FieldT> primary_input(assignment.begin(), assignment.begin() + cs.num_inputs());
+    const r1cs_auxiliary_input<FieldT> auxiliary_input(assignment.begin() + cs.num_inputs(), assignment.end());
+
+    cout << "constraints: " << numConstraints << " -> " << cs.num_constraints() << endl;
+    EXPECT_EQ(cs.num_variables(), assignment.size());
+    EXPECT_LT(cs.num_constraints(), numConstraints);
+    EXPECT_GT(eliminated, 0u);
+    EXPECT_LE(cs.num_constraints() + eliminated, numConstraints);
+    EXPECT_TRUE(cs.is_satisfied(primary_input, auxiliary_input));
+}
+
+/// gadgets not reaching the return value are dropped from the exported system
+void test_deadgadget()
+{
+    Gadget_Stats stats;
+    gadget_initEnv();
+    gadget_createPBVar(1);
+    gadget_createPBVar(2);
+    gadget_setVar(1, 7, true);
+    gadget_setVar(2, 5, true);
+
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 3, G_ADD));
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 4, G_MUL));
+    EXPECT_TRUE(gadget_createGadget(3, 2, 0, 5, G_SUB));
+    EXPECT_TRUE(gadget_createGadget(4, 1, 0, 6, G_UGT));
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 7, G_EQ));
+    EXPECT_TRUE(gadget_createGadget(1, 0, 0, 8, G_NOT));
+    gadget_setRetIndex(5);
+
+    gadget_generateConstraints();
+    gadget_generateWitness();
+    EXPECT_EQ(gadget_getVar(5), 7);
+    // the dead EQ and NOT rows would not hold on zero values
+    EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+
+    r1cs_constraint_system<FieldT> cs;
+    ExportConstraintSystem(2, cs);
+    const r1cs_variable_assignment<FieldT> assignment =
+        r1cs_project_assignment(GetVariableAssignment(), g_vectRemovedVars);
+    const r1cs_primary_input<FieldT> primary_input(assignment.begin(), assignment.begin() + cs.num_inputs());
+    const r1cs_auxiliary_input<FieldT> auxiliary_input(assignment.begin() + cs.num_inputs(), assignment.end());
+    EXPECT_TRUE(cs.is_satisfied(primary_input, auxiliary_input));
+
+    gadget_getStats(&stats);
+    cout << "gadgets: " << stats.Gadgets << ", dropped gadgets: " << stats.DroppedGadgets
+         << ", dropped constraints: " << stats.DroppedConstraints
+         << ", dropped variables: " << stats.DroppedVars << endl;
+    EXPECT_EQ(stats.Gadgets, 6u);
+    EXPECT_EQ(stats.DroppedGadgets, 4u);
+    // MUL 1, UGT 202, EQ 2, NOT 3
+    EXPECT_EQ(stats.DroppedConstraints, 208u);
+    EXPECT_GT(stats.DroppedVars, 0u);
+    EXPECT_EQ(stats.RemovedVars, g_vectRemovedVars.size());
+    EXPECT_EQ(DenseProtoboard::find(g_pbp)->sparseR1CS().numConstraints(), 2u);
+    gadget_uninitEnv();
+}
+
+/// a public output the return value does not depend on keeps its gadget, whether it
+/// is marked by gadget_setPublicVar (pass 0) or one of the exported primary inputs
+void test_public_output()
+{
+    for (int pass = 0; pass < 2; pass++) {
+        gadget_initEnv();
+        gadget_createPBVar(1);
+        gadget_createPBVar(2);
+        gadget_createPBVar(3);
+        if (pass == 0)
+            gadget_setPublicVar(2);
+        gadget_setVar(1, 7, true);
+        gadget_setVar(3, 5, true);
+
+        EXPECT_TRUE(gadget_createGadget(1, 3, 0, 2, G_ADD));
+        EXPECT_TRUE(gadget_createGadget(1, 3, 0, 4, G_MUL));
+        gadget_setRetIndex(4);
+        gadget_generateConstraints();
+        gadget_generateWitness();
+
+        r1cs_constraint_system<FieldT> cs;
+        ExportConstraintSystem(2, cs);
+        r1cs_primary_input<FieldT> primary_input;
+        r1cs_auxiliary_input<FieldT> auxiliary_input;
+        GetProverInput(cs.num_inputs(), primary_input, auxiliary_input);
+        EXPECT_EQ(gadget_getVar(2), 12);
+        EXPECT_TRUE(primary_input[1] == FieldT(12));
+        EXPECT_TRUE(cs.is_satisfied(primary_input, auxiliary_input));
+        // the verifier must not accept another output
+        primary_input[1] = FieldT(13);
+        EXPECT_FALSE(cs.is_satisfied(primary_input, auxiliary_input));
+        gadget_uninitEnv();
+    }
+}
+
+/// numConstraints of each gadget type is the number of rows it generates
+void test_numconstraints()
+{
+    gadget_initEnv();
+    for (int64_t ptr = 1; ptr <= 2; ptr++)
+        gadget_createPBVar(ptr);
+    gadget_setVar(1, 7, true);
+    gadget_setVar(2, 5, true);
+    gadget_setConstVar(3, 5000);
+    gadget_setConstVar(4, 8);
+    gadget_setConstVar(5, -5000);
+    gadget_setCSE(false);
+
+    int64_t result = 100;
+    for (int32 type : {G_ADD, G_SUB, G_MUL, G_SDIV, G_SREM, G_UDIV, G_UREM, G_AND, G_OR,
+                       G_BITW_OR, G_BITW_XOR, G_BITW_AND, G_EQ, G_NEQ, G_SGT, G_SGE, G_UGT, G_UGE, G_POW})
+        EXPECT_TRUE(gadget_createGadget(1, 2, 0, result++, type));
+    for (int32 type : {G_MUL, G_UDIV, G_UREM, G_EQ, G_NEQ, G_SGT, G_SGE, G_UGT, G_UGE, G_POW}) {
+        EXPECT_TRUE(gadget_createGadget(1, 3, 0, result++, type));
+        EXPECT_TRUE(gadget_createGadget(4, 1, 0, result++, type));
+        EXPECT_TRUE(gadget_createGadget(1, 5, 0, result++, type));
+    }
+    EXPECT_TRUE(gadget_createGadget(1, 4, 0, result++, G_UDIV));
+    EXPECT_TRUE(gadget_createGadget(1, 0, 0, result++, G_NOT));
+    EXPECT_TRUE(gadget_createGadget(112, 1, 2, result++, G_SELECT));     // 112: the G_EQ result
+    EXPECT_TRUE(gadget_createGadget(1, 2, 3, result++, G_POWMOD));
+    EXPECT_TRUE(gadget_createGadget(1, 4, 3, result++, G_POWMOD));
+    EXPECT_TRUE(gadget_createGadget(1, 2, 4, result++, G_POWMOD));
+    EXPECT_TRUE(gadget_createGadget(1, 64, 32, result++, G_TRUNC));
+    EXPECT_TRUE(gadget_createGadget(1, 32, 64, result++, G_ZEXT));
+    EXPECT_TRUE(gadget_createGadget(1, 32, 64, result++, G_SEXT));
+
+    const SparseR1CS &R1CS = DenseProtoboard::find(g_pbp)->sparseR1CS();
+    for (size_t i = 0; i < g_vectGadgets.size(); i++) {
+        const size_t before = R1CS.numConstraints();
+        g_vectGadgets[i]->generateConstraints();
+        EXPECT_EQ(R1CS.numConstraints() - before, dynamic_cast<const DenseGadget&>(*g_vectGadgets[i]).numConstraints())
+            << "gadget " << i;
+    }
+    gadget_uninitEnv();
+}
+
+/// identical gadgets share one result variable
+void test_csegadget()
+{
+    Gadget_Stats stats;
+    gadget_initEnv();
+    gadget_setCSE(true);
+    gadget_createPBVar(1);
+    gadget_createPBVar(2);
+    gadget_setConstVar(3, 5000);
+    gadget_setConstVar(4, 5000);
+    gadget_setVar(1, 7, true);
+    gadget_setVar(2, 5, true);
+
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 10, G_ADD));
+    EXPECT_TRUE(gadget_createGadget(2, 1, 0, 11, G_ADD));
+    EXPECT_TRUE(gadget_createGadget(10, 3, 0, 12, G_UREM));
+    EXPECT_TRUE(gadget_createGadget(11, 4, 0, 13, G_UREM));
+    EXPECT_TRUE(gadget_createGadget(12, 13, 0, 14, G_SUB));
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 15, G_SUB));
+    gadget_generateConstraints();
+    gadget_generateWitness();
+
+    gadget_getStats(&stats);
+    EXPECT_EQ(stats.CseHits, 2u);
+    EXPECT_EQ(stats.Gadgets, 4u);
+    EXPECT_EQ(gadget_getVar(11), 12);
+    EXPECT_EQ(gadget_getVar(13), 12);
+    EXPECT_EQ(gadget_getVar(14), 0);
+    EXPECT_EQ(gadget_getVar(15), 2);
+    EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    gadget_setCSE(false);
+    gadget_uninitEnv();
+}
+
+/// independent lanes share witness levels; results do not depend on the schedule
+void test_parallel_witness()
+{
+    const int64_t lanes = 16;
+    gadget_initEnv();
+    gadget_createPBVar(1);
+    gadget_setVar(1, 0x5A5A, true);
+    for (int64_t i = 0; i < lanes; i++) {
+        const int64_t x = 100 + 10 * i;
+        gadget_createPBVar(x);
+        gadget_setVar(x, 1000 + i, true);
+        EXPECT_TRUE(gadget_createGadget(x, 1, 0, x + 1, G_ADD));
+        EXPECT_TRUE(gadget_createGadget(x + 1, 1, 0, x + 2, G_BITW_XOR));
+        EXPECT_TRUE(gadget_createGadget(x + 2, x, 0, x + 3, G_EQ));
+        EXPECT_TRUE(gadget_createGadget(x + 2, x + 1, 0, x + 4, G_UGT));
+    }
+    gadget_generateConstraints();
+    gadget_generateWitness();
+
+    for (int64_t i = 0; i < lanes; i++) {
+        const int64_t x = 100 + 10 * i;
+        const long sum = 1000 + i + 0x5A5A;
+        EXPECT_EQ(gadget_getVar(x + 1), sum);
+        EXPECT_EQ(gadget_getVar(x + 2), sum ^ 0x5A5A);
+        EXPECT_EQ(gadget_getVar(x + 3), (sum ^ 0x5A5A) == 1000 + i ? 1 : 0);
+        EXPECT_EQ(gadget_getVar(x + 4), (sum ^ 0x5A5A) > sum ? 1 : 0);
+    }
+    EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    gadget_uninitEnv();
+}
+
+/// a second parallel witness rewrites the inverses the first one left queued
+/// (EQ inputs differ in the first run and are equal in the second)
+void test_parallel_inverses()
+{
+    const int64_t lanes = 64;
+    gadget_initEnv();
+    gadget_createPBVar(1);
+    gadget_setVar(1, 5, true);
+    for (int64_t i = 0; i < lanes; i++) {
+        const int64_t x = 100 + 10 * i;
+        gadget_createPBVar(x);
+        EXPECT_TRUE(gadget_createGadget(x, 1, 0, x + 1, G_EQ));
+        EXPECT_TRUE(gadget_createGadget(x, 1, 0, x + 2, G_NEQ));
+    }
+    gadget_generateConstraints();
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int64_t i = 0; i < lanes; i++)
+            gadget_setVar(100 + 10 * i, pass == 0 ? 6 + i : 5, true);
+        gadget_generateWitness();
+        for (int64_t i = 0; i < lanes; i++) {
+            EXPECT_EQ(gadget_getVar(100 + 10 * i + 1), pass);
+            EXPECT_EQ(gadget_getVar(100 + 10 * i + 2), 1 - pass);
+        }
+    }
+    EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    gadget_uninitEnv();
+}
+
+/// the op tape computes what the gadgets' generateWitness does
+void test_witness_tape()
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = DenseProtoboard::create(R1P);
+    DenseProtoboard *dense = DenseProtoboard::find(pb);
+    Variable A("A"), B("B"), big("big"), flag("flag"), off("off");
+    Variable sum("sum"), wrap("wrap"), diff("diff"), neg("neg"), prod("prod"), scaled("scaled");
+    Variable land("land"), lor("lor"), bwxor("bwxor");
+    GadgetPtr gadgets[] = {
+        ADD_Gadget::create(pb, A, B, sum),
+        ADD_Gadget::create(pb, big, big, wrap),
+        SUB_Gadget::create(pb, A, B, diff),
+        SUB_Gadget::create(pb, B, A, neg),
+        MUL_Gadget::create(pb, A, B, prod),
+        MULConst_Gadget::create(pb, A, -3, scaled),
+        LOGIC_Gadget::create(pb, flag, off, false, land),
+        LOGIC_Gadget::create(pb, flag, off, true, lor),
+        BITWISE_XOR_Gadget::create(pb, A, B, bwxor),
+    };
+    const Variable *results[] = {&sum, &wrap, &diff, &neg, &prod, &scaled, &land, &lor, &bwxor};
+
+    WitnessTape tape;
+    for (auto &gadget : gadgets) {
+        gadget->generateConstraints();
+        tape.append(*dense, gadget);
+    }
+    EXPECT_EQ(tape.size(), sizeof(gadgets) / sizeof(gadgets[0]));
+
+    dense->val(A) = 1000;
+    dense->val(B) = 7;
+    dense->val(big) = ULONG_MAX;
+    dense->val(flag) = 1;
+    dense->val(off) = 0;
+    for (size_t i = 0; i < tape.size(); i++)
+        tape.run(*dense, i);
+    EXPECT_TRUE(dense->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+
+    FlatElem expected[sizeof(results) / sizeof(results[0])];
+    for (size_t i = 0; i < tape.size(); i++) {
+        expected[i] = dense->val(*results[i]);
+        dense->val(*results[i]) = 0;
+    }
+    for (auto &gadget : gadgets)
+        gadget->generateWitness();
+    for (size_t i = 0; i < tape.size(); i++)
+        EXPECT_TRUE(FlatElem(dense->val(*results[i])) == expected[i]);
+    EXPECT_EQ(dense->val(sum).asLong(), 1007);
+    EXPECT_TRUE(FlatElem(dense->val(neg)) == FlatElem(-993L));
+    EXPECT_EQ(dense->val(land).asLong(), 0);
+    EXPECT_EQ(dense->val(lor).asLong(), 1);
+}
+
+/// generated witness code: simple ops inline, other gadgets through the tape
+void test_witness_code()
+{
+    gadget_initEnv();
+    gadget_createPBVar(1);
+    gadget_createPBVar(2);
+    gadget_setVar(1, 1000, true);
+    gadget_setVar(2, 7, true);
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 3, G_ADD));
+    EXPECT_TRUE(gadget_createGadget(3, 2, 0, 4, G_BITW_XOR));
+    EXPECT_TRUE(gadget_createGadget(4, 1, 0, 5, G_SUB));
+    gadget_setRetIndex(5);
+
+    const char *path = "test_witness_code.cpp";
+    EXPECT_TRUE(gadget_emitWitnessCode(path, "contract_witness"));
+    std::ifstream in(path);
+    const std::string code((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_NE(code.find("extern \"C\" void contract_witness(const Witness_Api *api"), std::string::npos);
+    EXPECT_NE(code.find("contract_witness_ops = 3;"), std::string::npos);
+    EXPECT_NE(code.find("__builtin_add_overflow"), std::string::npos); // ADD inline
+    EXPECT_NE(code.find("api->run(api->ctx, 1);"), std::string::npos); // BITWISE_XOR interpreted
+    remove(path);
+
+    // not compiled here: the tape keeps running
+    EXPECT_FALSE(gadget_loadWitnessCode("./no_such_witness.so", "contract_witness"));
+    gadget_generateConstraints();
+    gadget_generateWitness();
+    EXPECT_EQ(gadget_getVar(5), (1007 ^ 7) - 1000);
+    EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    gadget_uninitEnv();
+}
+
+/// circuit of test_witness_code_compiled; changed swaps the operands of op 4
+static void build_witness_code_circuit(bool changed)
+{
+    gadget_initEnv();
+    gadget_createPBVar(1);
+    gadget_createPBVar(2);
+    gadget_setVar(1, 1000, true);
+    gadget_setVar(2, 7, true);
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 3, G_ADD));
+    EXPECT_TRUE(gadget_createGadget(3, 2, 0, 4, G_BITW_XOR));
+    EXPECT_TRUE(gadget_createGadget(4, 1, 0, 5, G_SUB));
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 6, G_MUL));
+    EXPECT_TRUE(gadget_createGadget(changed ? 1 : 2, changed ? 2 : 1, 0, 7, G_SUB)); // negative: RUN fallback
+    EXPECT_TRUE(gadget_createGadget(5, 6, 0, 8, G_ADD));
+    EXPECT_TRUE(gadget_createGadget(7, 2, 0, 9, G_MUL));                   // field operand
+    gadget_addOutput(9);
+    gadget_setRetIndex(8);
+    gadget_generateConstraints();
+}
+
+/// compile the generated witness code, load it and compare its witness with the tape's
+void test_witness_code_compiled()
+{
+    const std::string src = std::string(__FILE__).substr(0, std::string(__FILE__).rfind("/test/"));
+    const char *compiler = getenv("CXX") ? getenv("CXX") : "c++";
+    const char *code = "test_witness_code_compiled.cpp";
+    const char *lib = "./test_witness_code_compiled.so";
+    long expected[10];
+
+    // the tape
+    build_witness_code_circuit(false);
+    EXPECT_TRUE(gadget_emitWitnessCode(code, "compiled_witness"));
+    gadget_generateWitness();
+    for (int64_t x = 3; x <= 9; x++)
+        expected[x] = gadget_getVar(x);
+    EXPECT_EQ(expected[8], (1007 ^ 7) - 1000 + 7000);
+    gadget_uninitEnv();
+
+    const std::string cmd = std::string(compiler) + " -std=c++11 -O1 -shared -fPIC -I" + src + " " + code + " -o " + lib;
+    ASSERT_EQ(system(cmd.c_str()), 0) << cmd;
+
+    // the compiled function on the same circuit
+    build_witness_code_circuit(false);
+    EXPECT_TRUE(gadget_loadWitnessCode(lib, "compiled_witness"));
+    EXPECT_TRUE(g_pfnWitness != nullptr);
+    gadget_generateWitness();
+    for (int64_t x = 3; x <= 9; x++)
+        EXPECT_EQ(gadget_getVar(x), expected[x]) << "variable " << x;
+    EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+
+    // a gadget added after loading rebuilds the tape and drops the function
+    EXPECT_TRUE(gadget_createGadget(8, 1, 0, 10, G_ADD));
+    gadget_addOutput(10);
+    gadget_generateConstraints();
+    gadget_generateWitness();
+    EXPECT_TRUE(g_pfnWitness == nullptr);
+    EXPECT_EQ(gadget_getVar(10), expected[8] + 1000);
+    gadget_uninitEnv();
+
+    // same op and live counts, other slots: rejected by the hash
+    build_witness_code_circuit(true);
+    EXPECT_FALSE(gadget_loadWitnessCode(lib, "compiled_witness"));
+    gadget_uninitEnv();
+    remove(code);
+    remove(lib + 2);
+}
+
+/// save a circuit, rebuild it from the file and compare constraints and witness
+void test_circuit_file()
+{
+    const char *path = "test_circuit_file.bin";
+    size_t constraints[2];
+    long result[2];
+    for (int pass = 0; pass < 2; pass++) {
+        gadget_initEnv();
+        if (pass == 0) {
+            gadget_createPBVar(1);
+            gadget_createPBVar(2);
+            gadget_setPublicVar(1);
+            gadget_setConstVar(10, 3);
+            EXPECT_TRUE(gadget_createGadget(1, 2, 0, 3, G_ADD));
+            EXPECT_TRUE(gadget_createGadget(3, 10, 0, 4, G_MUL));
+            EXPECT_TRUE(gadget_createGadget(4, 1, 0, 5, G_UGT));
+            EXPECT_TRUE(gadget_createGadget(1, 2, 0, 6, G_ADD)); // cse hit if enabled
+            gadget_addOutput(6);
+            gadget_setRetIndex(5);
+            EXPECT_TRUE(gadget_saveCircuit(path));
+        } else {
+            EXPECT_TRUE(gadget_loadCircuit(path));
+            EXPECT_FALSE(gadget_loadCircuit(path)); // not an empty environment
+        }
+        EXPECT_EQ(gadget_getPublicVarCount(), 1u);
+        gadget_setVar(1, 20, true);
+        gadget_setVar(2, 22, true);
+        gadget_generateConstraints();
+        gadget_generateWitness();
+        constraints[pass] = DenseProtoboard::find(g_pbp)->sparseR1CS().numConstraints();
+        result[pass] = gadget_getVar(5);
+        EXPECT_EQ(gadget_getVar(6), 42);
+        EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+        gadget_uninitEnv();
+    }
+    EXPECT_EQ(constraints[0], constraints[1]);
+    EXPECT_EQ(result[0], result[1]);
+
+    // a public variable created after others is the first variable once loaded
+    gadget_initEnv();
+    gadget_createPBVar(2);
+    gadget_createPBVar(1);
+    gadget_setPublicVar(1);
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 3, G_ADD));
+    gadget_setRetIndex(3);
+    EXPECT_NE(GadgetLibAdapter::getVariableIndex(*(Variable*)gadget_createPBVar(1)), 0u);
+    EXPECT_FALSE(gadget_checkPublicVars());
+    EXPECT_TRUE(gadget_saveCircuit(path));
+    gadget_uninitEnv();
+    gadget_initEnv();
+    EXPECT_TRUE(gadget_loadCircuit(path));
+    EXPECT_EQ(GadgetLibAdapter::getVariableIndex(*(Variable*)gadget_createPBVar(1)), 0u);
+    EXPECT_TRUE(gadget_checkPublicVars());
+    EXPECT_EQ(gadget_getPublicVarCount(), 1u);
+    gadget_uninitEnv();
+
+    // malformed node records: unknown type, zero result, zero input
+    const Circuit_Node badNodes[] = {
+        {G_POWMOD + 1, 0, {1, 2, 0}, 3},
+        {G_ADD, 0, {1, 2, 0}, 0},
+        {G_ADD, 0, {1, 0, 0}, 3},
+        {G_NOT, 0, {0, 0, 0}, 3},
+    };
+    for (const Circuit_Node &node : badNodes) {
+        const Circuit_Header header = {CIRCUIT_MAGIC, CIRCUIT_VERSION, 0, 0, 1, 0, 3};
+        {
+            std::ofstream out(path, std::ios::binary);
+            out.write((const char*)&header, sizeof(header));
+            out.write((const char*)&node, sizeof(node));
+        }
+        gadget_initEnv();
+        EXPECT_FALSE(gadget_loadCircuit(path));
+        EXPECT_EQ(g_vectGadgets.size(), 0u);
+        gadget_uninitEnv();
+    }
+
+    // truncated file
+    std::ofstream(path, std::ios::binary) << "CSIR";
+    gadget_initEnv();
+    EXPECT_FALSE(gadget_loadCircuit(path));
+    gadget_uninitEnv();
+    remove(path);
+}
+
+/// prove and verify with a proving key read back from the stream of
+/// r1cs_ppzksnark_generator_to_stream
+static bool prove_with_streamed_key(const std::string &pkey,
+                                    const r1cs_ppzksnark_verification_key<default_r1cs_ppzksnark_pp> &vk,
+                                    const r1cs_primary_input<FieldT> &primary_input,
+                                    const r1cs_auxiliary_input<FieldT> &auxiliary_input)
+{
+    r1cs_ppzksnark_proving_key<default_r1cs_ppzksnark_pp> pk;
+    std::istringstream in(pkey);
+    in >> pk;
+    if (in.fail())
+        return false;
+    const r1cs_ppzksnark_proof<default_r1cs_ppzksnark_pp> proof =
+        r1cs_ppzksnark_prover<default_r1cs_ppzksnark_pp>(pk, primary_input, auxiliary_input);
+    return r1cs_ppzksnark_verifier_strong_IC<default_r1cs_ppzksnark_pp>(vk, primary_input, proof);
+}
+
+/// memory bounded key generation in many batches, straight and resumed after an
+/// interruption, gives keys that prove and verify
+void test_keygen_stream()
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+    auto pb = Protoboard::create(R1P);
+    Variable A("A"), B("B"), bwxor("bwxor"), Q("Q"), R("R");
+    GadgetPtr gadgets[] = {
+        BITWISE_XOR_Gadget::create(pb, A, B, bwxor),
+        UDivisionConst_Gadget::create(pb, bwxor, 7, Q, R),
+    };
+    for (auto &gadget : gadgets)
+        gadget->generateConstraints();
+    pb->val(A) = 0x1234;
+    pb->val(B) = 0x0FF0;
+    for (auto &gadget : gadgets)
+        gadget->generateWitness();
+
+    r1cs_constraint_system<FieldT> cs = get_constraint_system_from_gadgetlib2(*pb);
+    const r1cs_variable_assignment<FieldT> assignment = get_variable_assignment_from_gadgetlib2(*pb);
+    cs.primary_input_size = 2;
+    cs.auxiliary_input_size -= 2;
+    const r1cs_primary_input<FieldT> primary_input(assignment.begin(), assignment.begin() + 2);
+    const r1cs_auxiliary_input<FieldT> auxiliary_input(assignment.begin() + 2, assignment.end());
+    ASSERT_TRUE(cs.is_satisfied(primary_input, auxiliary_input));
+
+    // 1 KB: a handful of group elements per batch, every query takes several
+    const size_t memoryLimit = 1024;
+    ASSERT_GT(cs.num_variables(), 10 * memoryLimit / (sizeof(libff::G1<default_r1cs_ppzksnark_pp>) + sizeof(FieldT)));
+
+    // straight
+    {
+        r1cs_constraint_system<FieldT> keyed = cs;
+        std::stringstream pk;
+        const auto vk = r1cs_ppzksnark_generator_to_stream(keyed, pk, memoryLimit);
+        EXPECT_TRUE(prove_with_streamed_key(pk.str(), vk, primary_input, auxiliary_input));
+    }
+
+    // interrupted after the B query, then resumed from the state and the written prefix
+    {
+        struct interrupted {};
+        keygen_state state;
+        std::stringstream first;
+        r1cs_constraint_system<FieldT> keyed = cs;
+        EXPECT_THROW(r1cs_ppzksnark_generator_to_stream(keyed, first, memoryLimit, &state,
+                                                        [](const keygen_state &st) {
+                                                            if (st.sections == 2)
+                                                                throw interrupted();
+                                                        }),
+                     interrupted);
+        ASSERT_EQ(state.sections, 2u);
+
+        std::stringstream resumed;
+        resumed << first.str().substr(0, state.offset);
+        keyed = cs;
+        const auto vk = r1cs_ppzksnark_generator_to_stream(keyed, resumed, memoryLimit, &state);
+        EXPECT_EQ(state.sections, KEYGEN_SECTIONS);
+        EXPECT_TRUE(prove_with_streamed_key(resumed.str(), vk, primary_input, auxiliary_input));
+    }
+
+    // keypairGenToFile does not resume the checkpoint of another r1cs, and wipes
+    // its own checkpoint after success unless asked to keep it
+    {
+        const char *pkPath = "test_keygen_stream.pk", *checkpoint = "test_keygen_stream.ckpt";
+        keygen_state other;
+        other.num_constraints = cs.num_constraints();
+        other.num_inputs = cs.num_inputs();
+        other.num_variables = cs.num_variables();
+        other.sections = 2;
+        other.offset = 16;
+        other.fingerprint = std::string(64, '0');
+        EXPECT_TRUE(keygen_checkpoint_save(checkpoint, "secret", other));
+        std::ofstream(pkPath, std::ios::binary) << std::string(64, 'x');
+
+        std::string vkey;
+        r1cs_constraint_system<FieldT> keyed = cs;
+        EXPECT_TRUE(keypairGenToFile(keyed, pkPath, vkey, memoryLimit, checkpoint, "secret", false, PS_PPZKSNARK));
+        std::ifstream in(pkPath, std::ios::binary);
+        const std::string pk((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        EXPECT_NE(pk.substr(0, 16), std::string(16, 'x'));
+        EXPECT_FALSE(std::ifstream(checkpoint).good());
+
+        keyed = cs;
+        EXPECT_TRUE(keypairGenToFile(keyed, pkPath, vkey, memoryLimit, checkpoint, "secret", true, PS_PPZKSNARK));
+        EXPECT_TRUE(std::ifstream(checkpoint).good());
+        EXPECT_TRUE(secure_wipe(checkpoint));
+        remove(pkPath);
+    }
+}
+
+/// keygen checkpoint round trip, wrong passphrase, tampering and wipe
+void test_keygen_checkpoint()
+{
+    const std::string path = "test_keygen.ckpt";
+    keygen_state state;
+    state.num_constraints = 100;
+    state.num_inputs = 2;
+    state.num_variables = 60;
+    state.sections = 3;
+    state.offset = 123456;
+    state.t = FieldT(7);
+    state.rA = FieldT::random_element();
+    state.gamma = -FieldT(1);
+    state.fingerprint = std::string(64, 'a');
+    EXPECT_TRUE(keygen_checkpoint_save(path, "secret", state));
+
+    keygen_state loaded;
+    EXPECT_FALSE(keygen_checkpoint_load(path, "other", loaded));
+    EXPECT_TRUE(keygen_checkpoint_load(path, "secret", loaded));
+    EXPECT_EQ(loaded.num_constraints, 100u);
+    EXPECT_EQ(loaded.sections, 3u);
+    EXPECT_EQ(loaded.offset, 123456u);
+    EXPECT_EQ(loaded.fingerprint, state.fingerprint);
+    EXPECT_TRUE(loaded.t == state.t);
+    EXPECT_TRUE(loaded.rA == state.rA);
+    EXPECT_TRUE(loaded.gamma == state.gamma);
+
+    // flip a ciphertext byte
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekg(40);
+        const char c = f.get() ^ 1;
+        f.seekp(40);
+        f.put(c);
+    }
+    EXPECT_FALSE(keygen_checkpoint_load(path, "secret", loaded));
+
+    EXPECT_TRUE(secure_wipe(path));
+    EXPECT_FALSE(std::ifstream(path).good());
+}
+
+/// equal circuits share a fingerprint, the key store hands their keys back
+void test_key_store()
+{
+    // pass 2 changes a constant, pass 3 keys the first circuit for Groth16
+    char fingerprint[4][65];
+    for (int pass = 0; pass < 4; pass++) {
+        gadget_initEnv();
+        gadget_createPBVar(1);
+        gadget_createPBVar(2);
+        gadget_setConstVar(10, pass == 2 ? 5 : 3);
+        EXPECT_TRUE(gadget_createGadget(1, 2, 0, 3, G_ADD));
+        EXPECT_TRUE(gadget_createGadget(3, 10, 0, 4, G_UGT));
+        gadget_setRetIndex(4);
+        gadget_generateConstraints();
+        EXPECT_TRUE(gadget_getFingerprint(2, pass == 3 ? PS_GROTH16 : PS_PPZKSNARK, fingerprint[pass], sizeof(fingerprint[pass])));
+        EXPECT_EQ(strlen(fingerprint[pass]), 64u);
+        gadget_uninitEnv();
+    }
+    EXPECT_STREQ(fingerprint[0], fingerprint[1]);
+    EXPECT_STRNE(fingerprint[0], fingerprint[2]);
+    EXPECT_STRNE(fingerprint[0], fingerprint[3]);
+
+    // term order and duplicates do not matter
+    r1cs_constraint_system<FieldT> cs[2];
+    for (int i = 0; i < 2; i++) {
+        // 3 x1 + 4 x2 and 4 x2 + 2 x1 + x1
+        linear_combination<FieldT> a;
+        if (i == 0) {
+            a.add_term(1, FieldT(3));
+            a.add_term(2, FieldT(4));
+        } else {
+            a.add_term(2, FieldT(4));
+            a.add_term(1, FieldT(2));
+            a.add_term(1, FieldT(1));
+        }
+        cs[i].add_constraint(r1cs_constraint<FieldT>(a, FieldT(1), FieldT(0)));
+        cs[i].primary_input_size = 1;
+        cs[i].auxiliary_input_size = 1;
+    }
+    EXPECT_EQ(r1cs_fingerprint(cs[0], {}, "r1cs_ppzksnark"), r1cs_fingerprint(cs[1], {}, "r1cs_ppzksnark"));
+    EXPECT_NE(r1cs_fingerprint(cs[0], {}, "r1cs_ppzksnark"), r1cs_fingerprint(cs[0], {3}, "r1cs_ppzksnark"));
+    EXPECT_NE(r1cs_fingerprint(cs[0], {}, "r1cs_ppzksnark"), r1cs_fingerprint(cs[0], {}, "r1cs_gg_ppzksnark"));
+
+    const char *store = "test_key_store";
+    std::ofstream("test_store.pk") << "pk";
+    std::ofstream("test_store.vk") << "vk";
+    EXPECT_FALSE(gadget_fetchKeys(store, fingerprint[0], "test_fetch.pk", "test_fetch.vk"));
+    EXPECT_TRUE(gadget_storeKeys(store, fingerprint[0], "test_store.pk", "test_store.vk"));
+    EXPECT_TRUE(gadget_fetchKeys(store, fingerprint[0], "test_fetch.pk", "test_fetch.vk"));
+    std::string pk;
+    std::ifstream("test_fetch.pk") >> pk;
+    EXPECT_EQ(pk, "pk");
+
+    // a second pair for the same fingerprint does not replace the published one
+    std::ofstream("test_store.pk") << "pk2";
+    std::ofstream("test_store.vk") << "vk2";
+    EXPECT_TRUE(gadget_storeKeys(store, fingerprint[0], "test_store.pk", "test_store.vk"));
+    EXPECT_TRUE(gadget_fetchKeys(store, fingerprint[0], "test_fetch.pk", "test_fetch.vk"));
+    std::string vk;
+    std::ifstream("test_fetch.pk") >> pk;
+    std::ifstream("test_fetch.vk") >> vk;
+    EXPECT_EQ(pk, "pk");
+    EXPECT_EQ(vk, "vk");
+
+    for (const char *file : {"test_store.pk", "test_store.vk", "test_fetch.pk", "test_fetch.vk"})
+        remove(file);
+    const std::string published = std::string(store) + "/" + fingerprint[0];
+    remove((published + "/pk").c_str());
+    remove((published + "/vk").c_str());
+    remove(published.c_str());
+    remove(store);
+}
+
+/// keygen, prover and verifier of both proof systems on the src/report workload
+/// result = pow((a % b) * c, exponent); prints times and key/proof sizes
+void test_proof_systems(const int64_t exponent)
+{
+    for (int32 system : {PS_PPZKSNARK, PS_GROTH16}) {
+        gadget_initEnv();
+        // public inputs a, b, c and the result come first
+        for (int64_t var : {1, 2, 3, 9})
+            gadget_createPBVar(var);
+        gadget_setVar(1, 8, false);
+        gadget_setVar(2, 5, false);
+        gadget_setVar(3, 3, false);
+        gadget_setConstVar(10, exponent);
+        EXPECT_TRUE(gadget_createGadget(1, 2, 0, 4, G_SREM));
+        EXPECT_TRUE(gadget_createGadget(4, 3, 0, 5, G_MUL));
+        EXPECT_TRUE(gadget_createGadget(5, 10, 0, 9, G_POW));
+        gadget_setRetIndex(9);
+        gadget_generateConstraints();
+        gadget_generateWitness();
+
+        std::string pkey, vkey;
+        long long start = libff::get_nsec_time();
+        keypairGen(4, pkey, vkey, system);
+        const long long keygen = libff::get_nsec_time() - start;
+
+        std::vector<char> proof(0x10000), result(0x100);
+        start = libff::get_nsec_time();
+        EXPECT_TRUE(GenerateProof(pkey.c_str(), proof.data(), proof.size() - 1));
+        const long long prove = libff::get_nsec_time() - start;
+        EXPECT_TRUE(GenerateResult(9, result.data(), result.size()));
+
+        start = libff::get_nsec_time();
+        EXPECT_TRUE(Verify(vkey.c_str(), proof.data(), "8#5#3", result.data()));
+        const long long verify = libff::get_nsec_time() - start;
+        EXPECT_FALSE(Verify(vkey.c_str(), proof.data(), "8#5#4", result.data()));
+
+        cout << (system == PS_GROTH16 ? "groth16" : "ppzksnark") << " exponent " << exponent
+             << ": keygen " << keygen / 1000000 << " ms, prove " << prove / 1000000
+             << " ms, verify " << verify / 1000000 << " ms, pk " << pkey.size()
+             << " bytes, vk " << vkey.size() << " bytes, proof " << strlen(proof.data()) << " bytes" << endl;
+        gadget_uninitEnv();
+    }
+}
+
+/// witness and prover time of the src/report pow workload for 1 to maxThreads threads
+void test_thread_scaling(const int64_t exponent, const int maxThreads)
+{
+    gadget_initEnv();
+    for (int64_t var : {1, 2, 3, 9})
+        gadget_createPBVar(var);
+    gadget_setVar(1, 8, false);
+    gadget_setVar(2, 5, false);
+    gadget_setVar(3, 3, false);
+    gadget_setConstVar(10, exponent);
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 4, G_SREM));
+    EXPECT_TRUE(gadget_createGadget(4, 3, 0, 5, G_MUL));
+    EXPECT_TRUE(gadget_createGadget(5, 10, 0, 9, G_POW));
+    gadget_setRetIndex(9);
+    gadget_generateConstraints();
+
+    std::string pkey, vkey;
+    csnark_set_threads(0);
+    keypairGen(4, pkey, vkey, PS_PPZKSNARK);
+
+    std::vector<char> proof(0x10000);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        const int used = csnark_set_threads(threads);
+        long long start = libff::get_nsec_time();
+        gadget_generateWitness();
+        const long long witness = libff::get_nsec_time() - start;
+        start = libff::get_nsec_time();
+        EXPECT_TRUE(GenerateProof(pkey.c_str(), proof.data(), proof.size() - 1));
+        const long long prove = libff::get_nsec_time() - start;
+        cout << "threads " << used << ": witness " << witness / 1000000 << " ms, prove "
+             << prove / 1000000 << " ms" << endl;
+    }
+    csnark_set_threads(0);
+    gadget_uninitEnv();
+}
+
+/// same circuit with and without annotations; prints the constraint generation time
+void test_annotations(const int64_t lanes)
+{
+    size_t constraints[2];
+    for (int pass = 0; pass < 2; pass++) {
+        gadget_initEnv();
+        gadget_setAnnotations(pass == 0);
+#ifdef CSNARK_NO_ANNOTATIONS
+        EXPECT_TRUE(GADGET_NAME("name").empty());
+#else
+        EXPECT_EQ(GADGET_NAME("name").empty(), pass == 1);
+#endif
+        gadget_createPBVar(1);
+        gadget_setVar(1, 0x5A5A, true);
+        for (int64_t i = 0; i < lanes; i++) {
+            const int64_t x = 100 + 10 * i;
+            gadget_createPBVar(x);
+            gadget_setVar(x, 1000 + i, true);
+            EXPECT_TRUE(gadget_createGadget(x, 1, 0, x + 1, G_BITW_XOR));
+            EXPECT_TRUE(gadget_createGadget(x + 1, x, 0, x + 2, G_UGT));
+        }
+        const long long start = libff::get_nsec_time();
+        gadget_generateConstraints();
+        cout << "annotations " << (pass == 0 ? "on" : "off") << ": "
+             << (libff::get_nsec_time() - start) / 1000000 << " ms" << endl;
+        gadget_generateWitness();
+        constraints[pass] = DenseProtoboard::find(g_pbp)->sparseR1CS().numConstraints();
+        EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+        gadget_uninitEnv();
+    }
+    gadget_setAnnotations(true);
+    EXPECT_EQ(constraints[0], constraints[1]);
+}
+
+/// direct mode writes the rows gadgetlib2 would hold as Constraint objects
+void test_sparse_r1cs()
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = DenseProtoboard::create(R1P);
+    DenseProtoboard *dense = DenseProtoboard::find(pb);
+    Variable A("A"), B("B"), sum("sum"), bwand("bwand"), Q("Q"), R("R"), eq("eq");
+    GadgetPtr gadgets[] = {
+        ADD_Gadget::create(pb, A, B, sum),
+        BITWISE_AND_Gadget::create(pb, A, B, bwand),
+        UDivisionConst_Gadget::create(pb, A, 7, Q, R),
+        EQ_Gadget::create(pb, A, B, eq),
+    };
+    DenseProtoboard::ConstraintBuffer buffer;
+    {
+        DenseProtoboard::Recorder recorder(buffer);
+        for (auto &gadget : gadgets)
+            gadget->generateConstraints();
+    }
+    dense->replay(buffer);
+    dense->setDirect(true);
+    dense->replay(buffer);
+    EXPECT_TRUE(dense->isDirect());
+
+    const SparseR1CS &sparse = dense->sparseR1CS();
+    EXPECT_EQ(sparse.numConstraints(), pb->constraintSystem().getNumberOfConstraints());
+    EXPECT_GT(sparse.countUsedVariables(sparse.numConstraints()), 0u);
+    GadgetLibAdapter::constraint_sys_t rows;
+    for (size_t r = 0; r < sparse.numConstraints(); r++)
+        rows.insert(GadgetLibAdapter::constraint_t(sparse.A.row(r), sparse.B.row(r), sparse.C.row(r)));
+    EXPECT_TRUE(rows == GadgetLibAdapter().convert(pb->constraintSystem()));
+
+    dense->val(A) = 0x1234;
+    dense->val(B) = 0x0FF0;
+    for (auto &gadget : gadgets)
+        gadget->generateWitness();
+    EXPECT_TRUE(dense->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    dense->val(sum) = 1;
+    EXPECT_FALSE(dense->isSatisfied());
+}
+
+/// re-witnessing after gadget_setVar matches a full witness generation
+void test_regenerate_witness()
+{
+    gadget_initEnv();
+    for (int64_t x = 1; x <= 3; x++)
+        gadget_createPBVar(x);
+    gadget_setVar(1, 20, true);
+    gadget_setVar(2, 22, true);
+    gadget_setVar(3, 5, true);
+    EXPECT_TRUE(gadget_createGadget(1, 2, 0, 10, G_ADD));   // 10 = a + b
+    EXPECT_TRUE(gadget_createGadget(10, 3, 0, 11, G_MUL));  // 11 = 10 * c
+    EXPECT_TRUE(gadget_createGadget(2, 3, 0, 12, G_SUB));   // 12 = b - c
+    EXPECT_TRUE(gadget_createGadget(11, 12, 0, 13, G_UGT)); // 13 = 11 > 12
+    EXPECT_FALSE(gadget_createGadget(2, 3, 0, 10, G_SUB));  // 10 has its writer
+    gadget_addOutput(13);
+    gadget_generateConstraints();
+    gadget_generateWitness();
+    EXPECT_EQ(gadget_getVar(11), 210);
+    EXPECT_EQ(gadget_getVar(13), 1);
+
+    // only a changes: 10, 11 and 13 are recomputed
+    gadget_setVar(1, 0, true);
+    gadget_regenerateWitness();
+    EXPECT_EQ(gadget_getVar(10), 22);
+    EXPECT_EQ(gadget_getVar(11), 110);
+    EXPECT_EQ(gadget_getVar(12), 17);
+    EXPECT_EQ(gadget_getVar(13), 1);
+
+    // c changes: everything downstream of it
+    gadget_setVar(3, 0, true);
+    gadget_regenerateWitness();
+    EXPECT_EQ(gadget_getVar(11), 0);
+    EXPECT_EQ(gadget_getVar(12), 22);
+    EXPECT_EQ(gadget_getVar(13), 0);
+
+    // nothing set: nothing to do
+    gadget_regenerateWitness();
+    EXPECT_EQ(gadget_getVar(13), 0);
+
+    EXPECT_TRUE(DenseProtoboard::find(g_pbp)->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    gadget_uninitEnv();
+}
+
+/// constraints recorded in parallel are the ones a serial build adds, in the same order
+void test_parallel_constraints()
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = DenseProtoboard::create(R1P);
+    DenseProtoboard *dense = DenseProtoboard::find(pb);
+    Variable A("A"), B("B"), sum("sum"), bwxor("bwxor"), gt("gt"), Q("Q"), R("R");
+    GadgetPtr gadgets[] = {
+        ADD_Gadget::create(pb, A, B, sum),
+        BITWISE_XOR_Gadget::create(pb, A, B, bwxor),
+        UGT_Gadget::create(pb, A, B, gt),
+        UDivisionConst_Gadget::create(pb, A, 7, Q, R),
+        EQ_Gadget::create(pb, A, sum, Variable("eq")),
+    };
+    const long n = sizeof(gadgets) / sizeof(gadgets[0]);
+
+    ::std::vector<DenseProtoboard::ConstraintBuffer> serial(n), parallel(n);
+    for (long i = 0; i < n; i++) {
+        DenseProtoboard::Recorder recorder(serial[i]);
+        gadgets[i]->generateConstraints();
+    }
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (long i = 0; i < n; i++) {
+        DenseProtoboard::Recorder recorder(parallel[i]);
+        gadgets[i]->generateConstraints();
+    }
+    // nothing reached the constraint system while recording
+    EXPECT_EQ(pb->constraintSystem().getNumberOfConstraints(), 0u);
+
+    size_t total = 0;
+    for (long i = 0; i < n; i++) {
+        ASSERT_EQ(serial[i].size(), parallel[i].size());
+        EXPECT_FALSE(parallel[i].empty());
+        for (size_t k = 0; k < serial[i].size(); k++) {
+            const DenseProtoboard::RecordedConstraint &s = serial[i][k], &p = parallel[i][k];
+            EXPECT_EQ(s.name, p.name);
+            EXPECT_EQ(s.a.asString(), p.a.asString());
+            EXPECT_EQ(s.b.asString(), p.b.asString());
+            EXPECT_EQ(s.c.asString(), p.c.asString());
+            ASSERT_EQ(!s.boolVar, !p.boolVar);
+            if (s.boolVar) {
+                EXPECT_EQ(GadgetLibAdapter::getVariableIndex(*s.boolVar),
+                          GadgetLibAdapter::getVariableIndex(*p.boolVar));
+            }
+        }
+        dense->replay(parallel[i]);
+        total += parallel[i].size();
+    }
+    EXPECT_EQ(pb->constraintSystem().getNumberOfConstraints(), total);
+
+    dense->val(A) = 0x1234;
+    dense->val(B) = 0x0F0F;
+    for (auto &gadget : gadgets)
+        gadget->generateWitness();
+    dense->flush();
+    EXPECT_TRUE(pb->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+}
+
+/// gadgets evaluated on the dense assignment match the gadgetlib2 constraints after flush
+void test_densepb()
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = DenseProtoboard::create(R1P);
+    DenseProtoboard *dense = DenseProtoboard::find(pb);
+    ASSERT_TRUE(dense != NULL);
+    ASSERT_TRUE(DenseProtoboard::find(Protoboard::create(R1P)) == NULL);
+
+    Variable A("A"), B("B"), bwor("bwor"), Q("Q"), R("R");
+    Variable flagA("flagA"), flagB("flagB"), lor("lor"), land("land"), sel("sel");
+    Variable eq("eq"), neq("neq"), notA("notA");
+    GadgetPtr gadgets[] = {
+        BITWISE_OR_Gadget::create(pb, A, B, bwor),
+        UDivisionConst_Gadget::create(pb, A, 7, Q, R),
+        LOGIC_Gadget::create(pb, flagA, flagB, true, lor),
+        LOGIC_Gadget::create(pb, flagA, flagB, false, land),
+        Select_Gadget::create(pb, lor, A, B, sel),
+        EQ_Gadget::create(pb, A, B, eq),
+        NEQ_Gadget::create(pb, A, B, neq),
+        NOT_Gadget::create(pb, A, notA),
+    };
+    for (auto &gadget : gadgets)
+        gadget->generateConstraints();
+
+    dense->val(A) = 0x1234;
+    dense->val(B) = 0xF0F0;
+    dense->val(flagA) = 1;
+    dense->val(flagB) = 0;
+    for (auto &gadget : gadgets)
+        gadget->generateWitness();
+
+    EXPECT_EQ(dense->val(bwor).asLong(), 0x1234 | 0xF0F0);
+    EXPECT_EQ(dense->val(Q).asLong(), 0x1234 / 7);
+    EXPECT_EQ(dense->val(R).asLong(), 0x1234 % 7);
+    EXPECT_EQ(dense->val(lor).asLong(), 1);
+    EXPECT_EQ(dense->val(land).asLong(), 0);
+    EXPECT_EQ(dense->val(sel).asLong(), 0x1234);
+    EXPECT_EQ(dense->val(eq).asLong(), 0);
+    EXPECT_EQ(dense->val(neq).asLong(), 1);
+    EXPECT_EQ(dense->val(notA).asLong(), 0);
+
+    // nothing reaches the gadgetlib2 assignment before flush
+    EXPECT_EQ(pb->val(bwor).asLong(), 0);
+    dense->flush();
+    EXPECT_TRUE(pb->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+    EXPECT_EQ(pb->val(bwor).asLong(), 0x1234 | 0xF0F0);
+
+    // integers stay on the 64 bit shadow, negative values go to the field
+    Variable neg("neg"), big("big");
+    dense->val(neg) = -5L;
+    dense->val(big) = ULONG_MAX;
+    EXPECT_FALSE(dense->val(neg).hasWord());
+    EXPECT_TRUE(dense->val(big).hasWord());
+    EXPECT_TRUE(dense->val(bwor).hasWord());
+    EXPECT_TRUE(FlatElem(dense->val(neg)) == FlatElem(FElem(-5)));
+    EXPECT_TRUE(FlatElem(dense->val(big)) == FlatElem(FElem((size_t)ULONG_MAX)));
+}
+
+/// word level packing / unpacking on a DenseProtoboard
+void test_densebits()
+{
+    initPublicParamsFromDefaultPp();
+    gadgetlib2::GadgetLibAdapter::resetVariableIndex();
+
+    auto pb = DenseProtoboard::create(R1P);
+    DenseProtoboard *dense = DenseProtoboard::find(pb);
+    UnpackedWord bits(64, "bits");
+    VariableArray swapped;
+    swapped.emplace_back(bits[1]);
+    swapped.emplace_back(bits[0]);
+    Variable word("word"), repacked("repacked"), swappedWord("swappedWord");
+    EXPECT_GE(DenseProtoboard::firstIndexOf(bits), 0);
+    EXPECT_EQ(DenseProtoboard::firstIndexOf(swapped), -1);
+
+    GadgetPtr gadgets[] = {
+        Packing_Gadget::create(pb, bits, word, false),
+        Packing_Gadget::create(pb, bits, repacked, true),
+        Packing_Gadget::create(pb, swapped, swappedWord, true),
+    };
+    for (auto &gadget : gadgets)
+        gadget->generateConstraints();
+    dense->val(word) = 0x8000000000000005UL;
+    for (auto &gadget : gadgets)
+        gadget->generateWitness();
+
+    EXPECT_EQ(dense->val(bits[0]).asLong(), 1);
+    EXPECT_EQ(dense->val(bits[1]).asLong(), 0);
+    EXPECT_EQ(dense->val(bits[63]).asLong(), 1);
+    EXPECT_EQ((unsigned long)dense->val(repacked).asLong(), 0x8000000000000005UL);
+    EXPECT_EQ(dense->val(swappedWord).asLong(), 2);
+    dense->flush();
+    EXPECT_TRUE(pb->isSatisfied(PrintOptions::DBG_PRINT_IF_NOT_SATISFIED));
+}
+
+/// FlatElem arithmetic agrees with FElem
+void test_flatelem()
+{
+    initPublicParamsFromDefaultPp();
+
+    const long values[] = {0, 1, 2, -1, -7, 0x1234, LONG_MAX, LONG_MIN};
+    for (long a : values) {
+        EXPECT_EQ(FlatElem(a).asLong(), FElem(a).asLong());
+        EXPECT_TRUE(FlatElem(FElem(a)) == FlatElem(a));
+        EXPECT_TRUE(FlatElem(a).asFElem() == FElem(a));
+        for (long b : values) {
+            EXPECT_EQ((FlatElem(a) + FlatElem(b)).asLong(), (FElem(a) + FElem(b)).asLong());
+            EXPECT_EQ((FlatElem(a) - FlatElem(b)).asLong(), (FElem(a) - FElem(b)).asLong());
+            EXPECT_EQ((FlatElem(a) * FlatElem(b)).asLong(), (FElem(a) * FElem(b)).asLong());
+            EXPECT_EQ(FlatElem(a) == FlatElem(b), a == b);
+        }
+        if (a != 0) {
+            EXPECT_TRUE(FlatElem(a) * FlatElem(a).inverse() == 1);
+        }
+    }
+    EXPECT_EQ(FlatElem((unsigned long)ULONG_MAX).asLong(), FElem((size_t)ULONG_MAX).asLong());
+    EXPECT_TRUE(FlatElem((unsigned long)ULONG_MAX) != FlatElem(-1));
+}
 
 void exhaustive_test(ProtoboardPtr pb_, size_t num_input)
 {
@@ -612,7 +1985,7 @@ void test_gegadget() {
 int main(int argc, char *argv[])
 {
     int opt;
-    char *string = "t:z:s:m:";
+    char *string = "t:z:s:m:g:";
     char   *stop_at  = NULL ;
     while ((opt = getopt(argc, argv, string))!= -1)
     {
@@ -635,6 +2008,11 @@ int main(int argc, char *argv[])
         case 'm':
             test_modgadget();
             break;
+        case 'g':
+            //test-gadget -g5000
+            loop_guard_test(strtoul(optarg, &stop_at,0), 5000, false);
+            loop_guard_test(strtoul(optarg, &stop_at,0), 5000, true);
+            break;
         default:
             printf("no this opt = %c\t\t", opt);
             break;
@@ -658,6 +2036,34 @@ int main(int argc, char *argv[])
     //test_neqgadget();
     //test_gtgadget();
     //test_gegadget();
+    //test_mulconstgadget();
+    //test_udivconstgadget();
+    //test_cmpconstgadget();
+    //test_eqconstgadget();
+    //test_linear_elim(10);
+    //test_deadgadget();
+    //test_public_output();
+    //test_numconstraints();
+    //test_csegadget();
+    //test_powmodgadget();
+    //test_densepb();
+    //test_densebits();
+    //test_flatelem();
+    //test_parallel_witness();
+    //test_parallel_inverses();
+    //test_parallel_constraints();
+    //test_regenerate_witness();
+    //test_sparse_r1cs();
+    //test_annotations(1000);
+    //test_witness_tape();
+    //test_witness_code();
+    //test_witness_code_compiled();
+    //test_circuit_file();
+    //test_keygen_stream();
+    //test_keygen_checkpoint();
+    //test_key_store();
+    //test_proof_systems(5000);
+    //test_thread_scaling(5000, 64);
     
     return 0;
 }
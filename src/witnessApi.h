@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// interface between libcsnark and a witness function generated by
+/// gadget_emitWitnessCode (WitnessTape::emitCode)
+typedef struct tagWitnessApi {
+	void *ctx;
+	/// 64 bit word of an assignment slot, 0 if the slot only holds a field element
+	int  (*load)(void *ctx, size_t slot, uint64_t *word);
+	/// slot := word
+	void (*store)(void *ctx, size_t slot, uint64_t word);
+	/// interpreted witness of tape op (gadget) op
+	void (*run)(void *ctx, size_t op);
+}Witness_Api;
+
+/// generated witness function: word[slot] / valid[slot] cache the slots it reads,
+/// both preallocated by the library for every slot of the assignment
+typedef void (*Witness_Func)(const Witness_Api *api, uint64_t *word, unsigned char *valid);